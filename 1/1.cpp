@@ -1,10 +1,34 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <cmath>
 #include <utility>
 #include <stack>
 #include <chrono>
 #include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <array>
+#include <unordered_map>
+#include <optional>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <sstream>
+#include <iomanip>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 typedef std::vector<std::vector<unsigned>> Board;
 
@@ -44,30 +68,824 @@ Direction oposite(Direction d)
     }
 }
 constexpr const char* strings[] = {"left", "right", "up", "down", "???", "none"};
-struct Position
+class PatternDatabase
 {
-    int row, col;
+    static constexpr char MAGIC[8] = {'I', 'D', 'A', 'P', 'D', 'B', '0', '1'};
+    static constexpr std::uint8_t UNKNOWN = 0xFF;
+    struct Group
+    {
+        std::vector<unsigned> tiles;
+        const std::uint8_t* table;
+    };
+    unsigned k, emptyAtTheEnd;
+    std::vector<Group> groups;
+    std::vector<unsigned> groupOfTile;
+    std::vector<std::uint64_t> weightOfTile;
+    void* mapping = MAP_FAILED;
+    std::size_t mappingSize = 0;
+
+    static std::uint64_t power(std::uint64_t base, unsigned exp)
+    {
+        std::uint64_t res = 1;
+        while(exp--) res *= base;
+        return res;
+    }
+    static unsigned goalCell(unsigned tileNum, unsigned emptyAtTheEnd)
+    {
+        return tileNum - (tileNum <= emptyAtTheEnd);
+    }
+    static void validateGroups(unsigned k, const std::vector<std::vector<unsigned>>& groups)
+    {
+        std::vector<bool> used(k*k);
+        for(const auto& group: groups)
+        {
+            if(group.empty() || group.size() > 8)
+                throw std::logic_error("pattern groups should contain between 1 and 8 tiles");
+            for(unsigned tile: group)
+            {
+                if(!tile || tile >= k*k || used[tile])
+                    throw std::logic_error("pattern groups should be disjoint sets of tiles");
+                used[tile] = true;
+            }
+        }
+    }
+    // 0-1 BFS backwards from the goal over (pattern, blank) pairs: moving a pattern tile costs 1,
+    // moving any other tile costs 0, so the tables of disjoint groups can be added
+    static std::vector<std::uint8_t> generateTable(unsigned k, unsigned emptyAtTheEnd, const std::vector<unsigned>& tiles)
+    {
+        const unsigned cells = k*k;
+        const std::uint64_t entries = power(cells, tiles.size());
+        std::vector<std::uint64_t> weights(tiles.size());
+        std::uint64_t goalIndex = 0;
+        for(std::size_t j=0; j<tiles.size(); j++)
+        {
+            weights[j] = power(cells, j);
+            goalIndex += goalCell(tiles[j], emptyAtTheEnd)*weights[j];
+        }
+        std::vector<std::uint8_t> table(entries, UNKNOWN);
+        std::vector<std::uint64_t> visited((entries*cells+63)/64);
+        auto testAndSet = [&visited](std::uint64_t ext) {
+            std::uint64_t mask = std::uint64_t(1) << ext%64;
+            bool res = visited[ext/64] & mask;
+            visited[ext/64] |= mask;
+            return res;
+        };
+        std::vector<std::uint64_t> current, next{goalIndex*cells + emptyAtTheEnd};
+        std::vector<int> occupant(cells);
+        for(unsigned dist=0; !next.empty(); dist++)
+        {
+            if(dist == UNKNOWN)
+                throw std::logic_error("pattern database distance overflow");
+            current.clear();
+            std::swap(current, next);
+            std::size_t fresh = 0;
+            for(std::uint64_t ext: current)
+                if(!testAndSet(ext))
+                    current[fresh++] = ext;
+            current.resize(fresh);
+            while(!current.empty())
+            {
+                std::uint64_t ext = current.back(), index = ext/cells;
+                unsigned blank = ext%cells;
+                current.pop_back();
+                if(table[index] == UNKNOWN)
+                    table[index] = dist;
+                std::fill(occupant.begin(), occupant.end(), -1);
+                for(std::uint64_t rest=index, j=0; j<tiles.size(); j++, rest/=cells)
+                    occupant[rest%cells] = j;
+                unsigned row = blank/k, col = blank%k;
+                unsigned neighbours[4], cnt = 0;
+                if(col) neighbours[cnt++] = blank-1;
+                if(col+1 < k) neighbours[cnt++] = blank+1;
+                if(row) neighbours[cnt++] = blank-k;
+                if(row+1 < k) neighbours[cnt++] = blank+k;
+                for(unsigned i=0; i<cnt; i++)
+                {
+                    unsigned cell = neighbours[i];
+                    if(occupant[cell] < 0)
+                    {
+                        if(!testAndSet(index*cells + cell))
+                            current.push_back(index*cells + cell);
+                    }
+                    else
+                    {
+                        std::uint64_t w = weights[occupant[cell]], newExt = (index + w*blank - w*cell)*cells + cell;
+                        if(!(visited[newExt/64] & std::uint64_t(1) << newExt%64))
+                            next.push_back(newExt);
+                    }
+                }
+            }
+        }
+        return table;
+    }
+public:
+    static std::vector<std::vector<unsigned>> defaultGroups(unsigned k)
+    {
+        switch(k)
+        {
+        case 2:
+            return {{1, 2, 3}};
+        case 3:
+            return {{1, 2, 3, 4}, {5, 6, 7, 8}};
+        case 4:
+            return {{1, 5, 6, 9, 10, 13}, {7, 8, 11, 12, 14, 15}, {2, 3, 4}};
+        case 5:
+            return {{1, 2, 3, 6, 7, 8}, {4, 5, 9, 10, 14, 15}, {11, 12, 16, 17, 21, 22}, {13, 18, 19, 20, 23, 24}};
+        default:
+            throw std::logic_error("no default pattern database for this board size");
+        }
+    }
+    static void generate(const char* filename, unsigned k, unsigned emptyAtTheEnd, const std::vector<std::vector<unsigned>>& groups)
+    {
+        validateGroups(k, groups);
+        std::ofstream ofs(filename, std::ios::binary);
+        if(!ofs)
+            throw std::runtime_error(std::string("could not open ") + filename + " for writing");
+        auto writeU32 = [&ofs](std::uint32_t n) { ofs.write(reinterpret_cast<const char*>(&n), sizeof n); };
+        ofs.write(MAGIC, sizeof MAGIC);
+        writeU32(k);
+        writeU32(emptyAtTheEnd);
+        writeU32(groups.size());
+        for(const auto& group: groups)
+        {
+            writeU32(group.size());
+            for(unsigned tile: group)
+                writeU32(tile);
+        }
+        for(const auto& group: groups)
+        {
+            std::vector<std::uint8_t> table = generateTable(k, emptyAtTheEnd, group);
+            ofs.write(reinterpret_cast<const char*>(table.data()), table.size());
+        }
+        if(!ofs)
+            throw std::runtime_error(std::string("could not write ") + filename);
+    }
+    explicit PatternDatabase(const char* filename)
+    {
+        int fd = open(filename, O_RDONLY);
+        if(fd < 0)
+            throw std::runtime_error(std::string("could not open ") + filename + " for reading");
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            mappingSize = st.st_size;
+            mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if(mapping == MAP_FAILED)
+            throw std::runtime_error(std::string("could not map ") + filename);
+        const char* data = static_cast<const char*>(mapping);
+        std::size_t offset = 0;
+        auto readU32 = [&]() {
+            if(offset+4 > mappingSize)
+                throw std::runtime_error("corrupted pattern database");
+            std::uint32_t n;
+            std::memcpy(&n, data+offset, sizeof n);
+            offset += sizeof n;
+            return n;
+        };
+        try
+        {
+            if(mappingSize < sizeof MAGIC || std::memcmp(data, MAGIC, sizeof MAGIC))
+                throw std::runtime_error(std::string(filename) + " is not a pattern database");
+            offset = sizeof MAGIC;
+            k = readU32();
+            emptyAtTheEnd = readU32();
+            std::vector<std::vector<unsigned>> tileGroups(readU32());
+            for(auto& group: tileGroups)
+            {
+                group.resize(readU32());
+                for(unsigned& tile: group)
+                    tile = readU32();
+            }
+            if(k < 2 || emptyAtTheEnd >= k*k)
+                throw std::runtime_error("corrupted pattern database");
+            validateGroups(k, tileGroups);
+            groupOfTile.assign(k*k, -1);
+            weightOfTile.assign(k*k, 0);
+            for(auto& group: tileGroups)
+            {
+                std::uint64_t entries = power(k*k, group.size());
+                if(mappingSize-offset < entries)
+                    throw std::runtime_error("corrupted pattern database");
+                for(std::size_t j=0; j<group.size(); j++)
+                {
+                    groupOfTile[group[j]] = groups.size();
+                    weightOfTile[group[j]] = power(k*k, j);
+                }
+                groups.push_back({std::move(group), reinterpret_cast<const std::uint8_t*>(data+offset)});
+                offset += entries;
+            }
+        }
+        catch(...)
+        {
+            munmap(mapping, mappingSize);
+            throw;
+        }
+    }
+    PatternDatabase(const PatternDatabase&) = delete;
+    PatternDatabase& operator=(const PatternDatabase&) = delete;
+    ~PatternDatabase()
+    {
+        munmap(mapping, mappingSize);
+    }
+    unsigned sides() const
+    {
+        return k;
+    }
+    unsigned goalEmptyPos() const
+    {
+        return emptyAtTheEnd;
+    }
+    std::size_t groupsCnt() const
+    {
+        return groups.size();
+    }
+    // tiles outside every group are not counted; they belong to group groupsCnt()
+    unsigned groupOf(unsigned tileNum) const
+    {
+        return groupOfTile[tileNum] == -1u? groups.size(): groupOfTile[tileNum];
+    }
+    std::uint64_t weightOf(unsigned tileNum) const
+    {
+        return weightOfTile[tileNum];
+    }
+    unsigned value(std::size_t group, std::uint64_t index) const
+    {
+        return groups[group].table[index];
+    }
+};
+
+// walking distance tables: a state is the k x k matrix of how many tiles with goal line j are in line i
+// (lines are rows for the vertical moves and columns for the horizontal ones), its value is the minimum number
+// of moves of tiles between adjacent lines needed to reach the goal matrix
+class WalkingDistance
+{
+    static constexpr std::uint32_t NO_STATE = -1;
+    unsigned k, blankGoalLine;
+    std::vector<std::uint8_t> dist;
+    std::vector<std::uint32_t> transitions; // [state][does the blank go to the higher line][goal line of the moved tile]
+    std::unordered_map<std::uint64_t, std::uint32_t> indices;
+    unsigned count(std::uint64_t code, unsigned line, unsigned goalLine) const
+    {
+        return code >> 3*(line*k+goalLine) & 7;
+    }
+    unsigned blankLine(std::uint64_t code) const
+    {
+        for(unsigned line=0; line<k; line++)
+        {
+            unsigned tiles = 0;
+            for(unsigned goalLine=0; goalLine<k; goalLine++)
+                tiles += count(code, line, goalLine);
+            if(tiles < k) return line;
+        }
+        throw std::logic_error("invalid walking distance state");
+    }
+public:
+    WalkingDistance(unsigned k, unsigned blankGoalLine): k(k), blankGoalLine(blankGoalLine)
+    {
+        if(k < 2 || k > 4)
+            throw std::logic_error("walking distance is supported only for boards from 2x2 to 4x4");
+        std::vector<std::uint64_t> codes{0}; // doubles as the BFS queue
+        for(unsigned line=0; line<k; line++)
+            codes[0] += std::uint64_t(k - (line == blankGoalLine)) << 3*(line*k+line);
+        indices[codes[0]] = 0;
+        dist.push_back(0);
+        for(std::size_t i=0; i<codes.size(); i++)
+        {
+            std::uint64_t code = codes[i];
+            unsigned blank = blankLine(code);
+            transitions.resize((i+1)*2*k, NO_STATE);
+            for(unsigned higher=0; higher<2; higher++)
+            {
+                if((!higher && !blank) || (higher && blank+1 == k)) continue;
+                unsigned from = higher? blank+1: blank-1;
+                for(unsigned goalLine=0; goalLine<k; goalLine++)
+                {
+                    if(!count(code, from, goalLine)) continue;
+                    std::uint64_t next = code - (std::uint64_t(1) << 3*(from*k+goalLine)) + (std::uint64_t(1) << 3*(blank*k+goalLine));
+                    auto [it, inserted] = indices.try_emplace(next, codes.size());
+                    if(inserted)
+                    {
+                        codes.push_back(next);
+                        dist.push_back(dist[i]+1);
+                    }
+                    transitions[(i*2+higher)*k+goalLine] = it->second;
+                }
+            }
+        }
+    }
+    unsigned sides() const
+    {
+        return k;
+    }
+    unsigned goalLine() const
+    {
+        return blankGoalLine;
+    }
+    // the code of a matrix has 3 bits for each count, line by line
+    std::uint64_t codeOf(unsigned line, unsigned goalLine) const
+    {
+        return std::uint64_t(1) << 3*(line*k+goalLine);
+    }
+    std::uint32_t index(std::uint64_t code) const
+    {
+        auto it = indices.find(code);
+        if(it == indices.end())
+            throw std::logic_error("invalid walking distance state");
+        return it->second;
+    }
+    unsigned value(std::uint32_t state) const
+    {
+        return dist[state];
+    }
+    std::uint32_t move(std::uint32_t state, bool blankToHigherLine, unsigned tileGoalLine) const
+    {
+        return transitions[(state*2+blankToHigherLine)*k+tileGoalLine];
+    }
+};
+
+enum class Heuristic
+{
+    MANHATTAN, LINEAR_CONFLICT, WALKING_DISTANCE, PATTERN_DATABASE
+};
+Heuristic parseHeuristic(const std::string& name)
+{
+    if(name == "manhattan") return Heuristic::MANHATTAN;
+    if(name == "linear-conflict") return Heuristic::LINEAR_CONFLICT;
+    if(name == "walking-distance") return Heuristic::WALKING_DISTANCE;
+    if(name == "pdb") return Heuristic::PATTERN_DATABASE;
+    throw std::invalid_argument("unknown heuristic " + name);
+}
+
+// the precomputed tables of a heuristic for one board size and goal
+struct HeuristicTables
+{
+    Heuristic kind = Heuristic::MANHATTAN;
+    std::unique_ptr<PatternDatabase> pdb;
+    std::shared_ptr<const WalkingDistance> rowsWd, colsWd;
+};
+
+bool fileExists(const char* filename)
+{
+    return std::ifstream(filename).good();
+}
+
+HeuristicTables loadHeuristicTables(Heuristic kind, unsigned k, unsigned emptyPos, const char* pdbFile)
+{
+    HeuristicTables tables;
+    tables.kind = kind;
+    switch(kind)
+    {
+    case Heuristic::WALKING_DISTANCE:
+        tables.rowsWd = std::make_shared<const WalkingDistance>(k, emptyPos/k);
+        tables.colsWd = emptyPos/k == emptyPos%k? tables.rowsWd: std::make_shared<const WalkingDistance>(k, emptyPos%k);
+        break;
+    case Heuristic::PATTERN_DATABASE:
+        if(!pdbFile)
+            throw std::invalid_argument("the pattern database heuristic needs a pattern database file");
+        if(!fileExists(pdbFile))
+        {
+            std::cerr << "generating pattern database " << pdbFile << "...\n";
+            PatternDatabase::generate(pdbFile, k, emptyPos, PatternDatabase::defaultGroups(k));
+        }
+        tables.pdb = std::make_unique<PatternDatabase>(pdbFile);
+        break;
+    default:
+        break;
+    }
+    return tables;
+}
+
+// per worker deques of task indices: a worker takes tasks from the front of its own deque
+// and steals from the back of the others' when it runs out
+class WorkStealingQueues
+{
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+    std::vector<Queue> queues;
+public:
+    WorkStealingQueues(unsigned workers, std::size_t tasks): queues(workers)
+    {
+        for(std::size_t i=0; i<tasks; i++)
+            queues[i%workers].tasks.push_back(i);
+    }
+    std::optional<std::size_t> pop(unsigned worker)
+    {
+        {
+            std::lock_guard lock(queues[worker].mutex);
+            if(!queues[worker].tasks.empty())
+            {
+                std::size_t task = queues[worker].tasks.front();
+                queues[worker].tasks.pop_front();
+                return task;
+            }
+        }
+        for(unsigned i=1; i<queues.size(); i++)
+        {
+            Queue& victim = queues[(worker+i)%queues.size()];
+            std::lock_guard lock(victim.mutex);
+            if(!victim.tasks.empty())
+            {
+                std::size_t task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+};
+
+// a pool of objects allocated in fixed-size blocks, so that they never move and can be referred to by 32-bit indices
+template<class T>
+class Arena
+{
+    static constexpr unsigned BLOCK_BITS = 12;
+    std::vector<std::unique_ptr<T[]>> blocks;
+    std::uint32_t cnt = 0;
+public:
+    T& operator[](std::uint32_t i)
+    {
+        return blocks[i >> BLOCK_BITS][i & ((1u << BLOCK_BITS) - 1)];
+    }
+    std::uint32_t add(const T& x)
+    {
+        if(!(cnt & ((1u << BLOCK_BITS) - 1)))
+            blocks.push_back(std::make_unique_for_overwrite<T[]>(1u << BLOCK_BITS));
+        (*this)[cnt] = x;
+        return cnt++;
+    }
+    std::uint32_t size() const
+    {
+        return cnt;
+    }
+    std::size_t bytes() const
+    {
+        return blocks.size()*sizeof(T) << BLOCK_BITS;
+    }
+    // the memory the next add allocates
+    std::size_t bytesToAdd() const
+    {
+        return cnt & ((1u << BLOCK_BITS) - 1)? 0: sizeof(T) << BLOCK_BITS;
+    }
+};
+
+// a bounded memory table of the smallest known g-value of the states, keyed by their Zobrist hashes
+class TranspositionTable
+{
+    static constexpr std::uint16_t EMPTY = -1;
+    struct Entry
+    {
+        std::uint64_t key = 0;
+        std::uint16_t g = EMPTY, bound = 0;
+    };
+    std::vector<Entry> entries;
+    std::uint64_t mask;
+    unsigned long long hits = 0, misses = 0;
+public:
+    explicit TranspositionTable(std::size_t bytes)
+    {
+        std::size_t cnt = 1;
+        while(2*cnt*sizeof(Entry) <= bytes)
+            cnt *= 2;
+        entries.resize(cnt);
+        mask = cnt-1;
+    }
+    // a state can be pruned if it was reached with a smaller g, or with the same g in the current iteration,
+    // as then its subtree is (or will be) searched from there with at least the same remaining bound
+    bool prune(std::uint64_t key, unsigned g, unsigned bound)
+    {
+        Entry& e = entries[key & mask];
+        if(e.key == key && e.g != EMPTY && (e.g < g || (e.g == g && e.bound == bound)))
+        {
+            hits++;
+            return true;
+        }
+        misses++;
+        e = {key, static_cast<std::uint16_t>(g), static_cast<std::uint16_t>(bound)};
+        return false;
+    }
+    unsigned long long hitsCnt() const
+    {
+        return hits;
+    }
+    unsigned long long missesCnt() const
+    {
+        return misses;
+    }
+};
+
+struct SolverOptions
+{
+    unsigned threads = 1;
+    std::size_t ttBytes = 0;
+    double timeLimit = 0; // in seconds, 0 for none
+    double weight = 1; // the heuristic is multiplied by it, so that the solution is at most that many times longer than optimal
+    bool staged = false;
+    std::size_t astarBytes = 0; // A* is tried first with this much memory, 0 for IDA* only
+};
+
+struct IterationStats
+{
+    unsigned bound;
+    unsigned long long expanded, generated;
+    double seconds;
+};
+
+struct SearchStats
+{
+    unsigned long long expanded = 0, generated = 0, ttHits = 0, ttMisses = 0;
+    unsigned iterations = 0, lowerBound = 0;
+    bool astarOutOfMemory = false;
+    std::vector<IterationStats> perIteration;
+    void addIteration(unsigned bound, unsigned long long expandedCnt, unsigned long long generatedCnt, double seconds)
+    {
+        iterations++;
+        expanded += expandedCnt;
+        generated += generatedCnt;
+        perIteration.push_back({bound, expandedCnt, generatedCnt, seconds});
+    }
+    void add(const TranspositionTable& tt)
+    {
+        ttHits += tt.hitsCnt();
+        ttMisses += tt.missesCnt();
+    }
+};
+
+template<unsigned K, bool PACKED = K*K*4 <= 64>
+class PackedBoard
+{
+    std::uint64_t bits = 0;
+public:
+    unsigned get(unsigned cell) const
+    {
+        return bits >> 4*cell & 0xF;
+    }
+    void set(unsigned cell, unsigned tileNum)
+    {
+        bits = (bits & ~(std::uint64_t(0xF) << 4*cell)) | std::uint64_t(tileNum) << 4*cell;
+    }
+    std::uint64_t packed() const
+    {
+        return bits;
+    }
+    // moves the tile from cell `from` to the empty cell `to` and returns its number
+    unsigned slide(unsigned from, unsigned to)
+    {
+        std::uint64_t tileNum = bits >> 4*from & 0xF;
+        bits ^= tileNum << 4*from | tileNum << 4*to;
+        return tileNum;
+    }
+    bool operator==(const PackedBoard&) const = default;
 };
 
+template<unsigned K>
+class PackedBoard<K, false>
+{
+    std::array<std::uint8_t, K*K> tiles{};
+public:
+    unsigned get(unsigned cell) const
+    {
+        return tiles[cell];
+    }
+    void set(unsigned cell, unsigned tileNum)
+    {
+        tiles[cell] = tileNum;
+    }
+    unsigned slide(unsigned from, unsigned to)
+    {
+        unsigned tileNum = tiles[to] = tiles[from];
+        tiles[from] = 0;
+        return tileNum;
+    }
+    bool operator==(const PackedBoard&) const = default;
+};
+
+// newEmptyPos<K>[cell][d] is the position of the blank after moving in direction d, or -1 if the move is impossible
+template<unsigned K>
+constexpr auto newEmptyPos = [] {
+    std::array<std::array<signed char, Direction::CNT>, K*K> res{};
+    for(unsigned cell=0; cell<K*K; cell++)
+    {
+        unsigned row = cell/K, col = cell%K;
+        res[cell][Direction::LEFT] = col+1 < K? cell+1: -1;
+        res[cell][Direction::RIGHT] = col? cell-1: -1;
+        res[cell][Direction::UP] = row+1 < K? cell+K: -1;
+        res[cell][Direction::DOWN] = row? cell-K: -1;
+    }
+    return res;
+}();
+
+template<unsigned K>
+constexpr auto zobristKeys = [] {
+    std::array<std::array<std::uint64_t, K*K>, K*K> res{}; // [tileNum][cell]
+    std::uint64_t x = K;
+    for(auto& tileKeys: res)
+        for(auto& key: tileKeys) // splitmix64
+        {
+            std::uint64_t z = x += 0x9E3779B97F4A7C15ull;
+            z = (z ^ z >> 30) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ z >> 27) * 0x94D049BB133111EBull;
+            key = z ^ z >> 31;
+        }
+    return res;
+}();
+
+struct Move
+{
+    Direction dir;
+    unsigned char newEmptyPos;
+};
+struct MoveList
+{
+    unsigned char cnt;
+    Move moves[Direction::CNT];
+    const Move* begin() const
+    {
+        return moves;
+    }
+    const Move* end() const
+    {
+        return moves+cnt;
+    }
+};
+// the possible moves for each blank position, in the order they are tried by the search
+template<unsigned K>
+constexpr auto possibleMoves = [] {
+    std::array<MoveList, K*K> res{};
+    for(unsigned cell=0; cell<K*K; cell++)
+        for(int d=Direction::CNT-1; d>=0; d--)
+            if(int newEmpty = newEmptyPos<K>[cell][d]; newEmpty >= 0)
+                res[cell].moves[res[cell].cnt++] = {static_cast<Direction>(d), static_cast<unsigned char>(newEmpty)};
+    return res;
+}();
+
+template<unsigned K>
 class State
 {
-    Board board;
-    Position currentEmptyPos;
-    unsigned emptyAtTheEnd, manhattan;
-    std::vector<Position> m_finalPositions;
+    static constexpr unsigned CELLS = K*K;
+    static constexpr std::size_t FRONTIER_SIZE = 4000;
+    static constexpr unsigned WEIGHT_SHIFT = 8;
+    PackedBoard<K> board;
+    unsigned currentEmptyPos, emptyAtTheEnd, manhattan;
+    std::array<std::array<std::uint8_t, CELLS>, CELLS> manhattanDists{}; // [tileNum][cell]
+    std::array<std::uint8_t, CELLS> targets{};
+    Heuristic kind;
+    const PatternDatabase* pdb = nullptr;
+    std::array<std::uint64_t, CELLS+1> pdbIndices{};
+    unsigned pdbHeuristic = 0;
+    std::array<std::uint32_t, K> rowCodes{}, colCodes{};
+    const std::vector<std::uint8_t>* lineConflicts = nullptr;
+    unsigned linearConflicts = 0;
+    const WalkingDistance *rowsWd = nullptr, *colsWd = nullptr;
+    std::uint32_t rowsWdIndex = 0, colsWdIndex = 0;
+    std::atomic<bool>* stop = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    TranspositionTable* tt = nullptr;
+    unsigned weight = 1 << WEIGHT_SHIFT; // fixed point
+    std::uint64_t hash = 0;
+    unsigned long long expanded = 0, generated = 0;
     void recalcTotalManhattan()
     {
         manhattan = 0;
-        int n = board.size();
-        for(int i=0; i<n; i++)
-            for(int j=0; j<n; j++)
-                if(board[i][j])
-                    manhattan += manhattanDist(board[i][j], i, j);
-                else currentEmptyPos = {i, j};
+        hash = 0;
+        for(unsigned i=0; i<CELLS; i++)
+            if(unsigned tile = board.get(i))
+            {
+                manhattan += manhattanDists[tile][i];
+                hash ^= zobristKeys<K>[tile][i];
+            }
+            else currentEmptyPos = i;
+    }
+    void recalcPatternDatabase()
+    {
+        pdbIndices.fill(0);
+        for(unsigned i=0; i<CELLS; i++)
+            if(unsigned tile = board.get(i))
+                pdbIndices[pdb->groupOf(tile)] += i*pdb->weightOf(tile);
+        pdbHeuristic = 0;
+        for(std::size_t group=0; group<pdb->groupsCnt(); group++)
+            pdbHeuristic += pdb->value(group, pdbIndices[group]);
+    }
+    void updatePatternDatabase(unsigned tileNum, unsigned from, unsigned to)
+    {
+        std::size_t group = pdb->groupOf(tileNum);
+        if(group == pdb->groupsCnt()) return;
+        std::uint64_t& index = pdbIndices[group], w = pdb->weightOf(tileNum);
+        pdbHeuristic -= pdb->value(group, index);
+        index = index + w*to - w*from;
+        pdbHeuristic += pdb->value(group, index);
+    }
+    // a line (row or column) is coded by the goal positions of its tiles in it, one base K+1 digit per cell,
+    // with K for the blank and the tiles whose goal is in another line
+    static constexpr auto powers = [] {
+        std::array<std::uint32_t, K+1> res{1};
+        for(unsigned i=1; i<=K; i++)
+            res[i] = res[i-1]*(K+1);
+        return res;
+    }();
+    // the minimum number of tiles that have to leave a line so that the rest can reach their goals in it
+    static const std::vector<std::uint8_t>& lineConflictsTable()
+    {
+        static const std::vector<std::uint8_t> table = [] {
+            std::vector<std::uint8_t> res(powers[K]);
+            for(std::uint32_t code=0; code<powers[K]; code++)
+            {
+                unsigned goals[K], longest[K], cnt = 0, maxLongest = 0;
+                for(std::uint32_t rest=code, i=0; i<K; i++, rest/=K+1)
+                    if(rest%(K+1) != K)
+                        goals[cnt++] = rest%(K+1);
+                for(unsigned i=0; i<cnt; i++) // the tiles in the longest increasing subsequence can stay
+                {
+                    longest[i] = 1;
+                    for(unsigned j=0; j<i; j++)
+                        if(goals[j] < goals[i] && longest[j]+1 > longest[i])
+                            longest[i] = longest[j]+1;
+                    if(longest[i] > maxLongest) maxLongest = longest[i];
+                }
+                res[code] = cnt - maxLongest;
+            }
+            return res;
+        }();
+        return table;
+    }
+    // the digit of tileNum in the code of a row or column
+    unsigned rowDigit(unsigned tileNum, unsigned line) const
+    {
+        return tileNum && row(targets[tileNum]) == line? col(targets[tileNum]): K;
+    }
+    unsigned colDigit(unsigned tileNum, unsigned line) const
+    {
+        return tileNum && col(targets[tileNum]) == line? row(targets[tileNum]): K;
+    }
+    void recalcLinearConflicts()
+    {
+        lineConflicts = &lineConflictsTable();
+        rowCodes.fill(0);
+        colCodes.fill(0);
+        for(unsigned i=0; i<CELLS; i++)
+        {
+            rowCodes[row(i)] += rowDigit(board.get(i), row(i))*powers[col(i)];
+            colCodes[col(i)] += colDigit(board.get(i), col(i))*powers[row(i)];
+        }
+        linearConflicts = 0;
+        for(unsigned line=0; line<K; line++)
+            linearConflicts += (*lineConflicts)[rowCodes[line]] + (*lineConflicts)[colCodes[line]];
+    }
+    // only the order in the lines crossed by the moved tile changes
+    void updateLinearConflicts(unsigned tileNum, unsigned from, unsigned to)
+    {
+        bool horizontal = row(from) == row(to);
+        auto& crossed = horizontal? colCodes: rowCodes;
+        auto& along = horizontal? rowCodes: colCodes;
+        unsigned fromLine = horizontal? col(from): row(from), toLine = horizontal? col(to): row(to), pos = horizontal? row(from): col(from);
+        auto digit = [&](unsigned line) { return horizontal? colDigit(tileNum, line): rowDigit(tileNum, line); };
+        linearConflicts -= (*lineConflicts)[crossed[fromLine]] + (*lineConflicts)[crossed[toLine]];
+        crossed[fromLine] += (K - digit(fromLine))*powers[pos];
+        crossed[toLine] -= (K - digit(toLine))*powers[pos];
+        linearConflicts += (*lineConflicts)[crossed[fromLine]] + (*lineConflicts)[crossed[toLine]];
+        unsigned alongDigit = horizontal? rowDigit(tileNum, pos): colDigit(tileNum, pos);
+        along[pos] += (alongDigit - K)*(powers[toLine] - powers[fromLine]);
+    }
+    void recalcWalkingDistance()
+    {
+        std::uint64_t rowsCode = 0, colsCode = 0;
+        for(unsigned i=0; i<CELLS; i++)
+            if(unsigned tile = board.get(i))
+            {
+                rowsCode += rowsWd->codeOf(row(i), row(targets[tile]));
+                colsCode += colsWd->codeOf(col(i), col(targets[tile]));
+            }
+        rowsWdIndex = rowsWd->index(rowsCode);
+        colsWdIndex = colsWd->index(colsCode);
+    }
+    void load(const PackedBoard<K>& b)
+    {
+        board = b;
+        recalcTotalManhattan();
+        switch(kind)
+        {
+        case Heuristic::LINEAR_CONFLICT:
+            recalcLinearConflicts();
+            break;
+        case Heuristic::WALKING_DISTANCE:
+            recalcWalkingDistance();
+            break;
+        case Heuristic::PATTERN_DATABASE:
+            recalcPatternDatabase();
+            break;
+        default:
+            break;
+        }
     }
-    unsigned manhattanDist(unsigned tileNum, int currentRow, int currentCol) const
+    void updateWalkingDistance(unsigned tileNum, unsigned from, unsigned to)
     {
-        return std::abs(currentRow-m_finalPositions[tileNum-1].row) + std::abs(currentCol-m_finalPositions[tileNum-1].col);
+        if(row(from) == row(to))
+            colsWdIndex = colsWd->move(colsWdIndex, col(from) > col(to), col(targets[tileNum]));
+        else rowsWdIndex = rowsWd->move(rowsWdIndex, row(from) > row(to), row(targets[tileNum]));
     }
     unsigned getTargetPosInd(unsigned tileNum) const
     {
@@ -76,125 +894,537 @@ class State
     unsigned countInversions() const
     {
         unsigned inversions = 0;
-        std::size_t cells = board.size()*board.size();
-        for(std::size_t i=0; i<cells; i++)
-            for(std::size_t j=i+1; j<cells; j++)
+        for(unsigned i=0; i<CELLS; i++)
+            for(unsigned j=i+1; j<CELLS; j++)
             {
-                unsigned tile1 = at(i), tile2 = at(j);
+                unsigned tile1 = board.get(i), tile2 = board.get(j);
                 if(tile1>tile2 && tile1 && tile2)
                     inversions++;
             }
         return inversions;
     }
-    Position getPosition(std::size_t ind) const
+    static unsigned row(unsigned ind)
+    {
+        return ind/K;
+    }
+    static unsigned col(unsigned ind)
+    {
+        return ind%K;
+    }
+    // rounding down keeps g + weighted(h) <= weight*(g + h), which bounds the cost of the solution
+    unsigned weighted(unsigned h) const
+    {
+        return h*weight >> WEIGHT_SHIFT;
+    }
+    // calls f with the heuristic as a compile-time constant, so that the search is specialized for it
+    template<class F>
+    decltype(auto) withHeuristic(F&& f) const
+    {
+        switch(kind)
+        {
+        case Heuristic::LINEAR_CONFLICT:
+            return f(std::integral_constant<Heuristic, Heuristic::LINEAR_CONFLICT>{});
+        case Heuristic::WALKING_DISTANCE:
+            return f(std::integral_constant<Heuristic, Heuristic::WALKING_DISTANCE>{});
+        case Heuristic::PATTERN_DATABASE:
+            return f(std::integral_constant<Heuristic, Heuristic::PATTERN_DATABASE>{});
+        default:
+            return f(std::integral_constant<Heuristic, Heuristic::MANHATTAN>{});
+        }
+    }
+    // the stop flag is polled every 1024 expanded nodes and the clock every 65536; returns true if the search should stop
+    bool shouldStop()
+    {
+        if(!(expanded & 0x3FF) && stop
+           && (stop->load(std::memory_order_relaxed) || (!(expanded & 0xFFFF) && std::chrono::steady_clock::now() >= deadline)))
+        {
+            stop->store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+    // a child returns -1 without a bound both when it is stopped and when all of its subtree was pruned
+    bool stopped(unsigned childBound) const
+    {
+        return childBound == -1u && stop && stop->load(std::memory_order_relaxed);
+    }
+    // the moves are written to path[g], path[g+1], ..., so it needs room for bound moves; when a solution is found,
+    // its length is returned instead of the next bound; the hash is kept up to date only for the transposition table
+    template<Heuristic H, bool TT>
+    std::pair<unsigned, bool> search(Direction* path, unsigned g, unsigned bound, unsigned prevEmptyPos)
+    {
+        unsigned f = g + weighted(heuristic<H>());
+        if(f > bound) return {f, false};
+        if(isSolved()) return {g, true};
+        if constexpr(TT)
+            if(tt->prune(hash, g, bound)) return {-1u, false};
+        ++expanded;
+        if(shouldStop()) return {-1u, false};
+        unsigned min = -1, emptyPos = currentEmptyPos;
+        for(auto [dir, newEmpty]: possibleMoves<K>[emptyPos])
+        {
+            if(newEmpty == prevEmptyPos) continue;
+            generated++;
+            if(unsigned childF = g+1+weighted(heuristicAfter<H>(newEmpty)); childF > bound) // cut off leaves without moving
+            {
+                if(childF < min) min = childF;
+                continue;
+            }
+            slideInto<H, TT>(newEmpty);
+            path[g] = dir;
+            auto t = search<H, TT>(path, g+1, bound, emptyPos);
+            if(t.second || stopped(t.first)) return t;
+            if(t.first < min) min = t.first;
+            slideInto<H, TT>(emptyPos);
+        }
+        return {min, false};
+    }
+    // search for Manhattan distance on a packed board, without a weight or a transposition table: the board and the heuristic
+    // are arguments instead of members that are updated and restored around each child, and the blank and its previous
+    // position are template parameters, so the moves are unrolled with constant shifts and the move back is left out
+    template<unsigned BLANK, unsigned PREV>
+    std::pair<unsigned, bool> searchPacked(Direction* path, std::uint64_t bits, unsigned h, unsigned g, unsigned bound)
+    {
+        if(!h) return {g, true};
+        ++expanded;
+        if(shouldStop()) return {-1u, false};
+        constexpr MoveList moves = possibleMoves<K>[BLANK];
+        unsigned min = -1, generatedHere = 0;
+        std::pair<unsigned, bool> res;
+        auto tryMove = [&]<unsigned I>(std::integral_constant<unsigned, I>) {
+            constexpr unsigned NEW_EMPTY = moves.moves[I].newEmptyPos;
+            if constexpr(NEW_EMPTY == PREV)
+                return false;
+            else
+            {
+                generatedHere++;
+                std::uint64_t tile = bits >> 4*NEW_EMPTY & 0xF;
+                unsigned childH = h + manhattanDists[tile][BLANK] - manhattanDists[tile][NEW_EMPTY];
+                if(unsigned childF = g+1+childH; childF > bound)
+                {
+                    if(childF < min) min = childF;
+                    return false;
+                }
+                path[g] = moves.moves[I].dir;
+                auto t = searchPacked<NEW_EMPTY, BLANK>(path, bits ^ (tile << 4*NEW_EMPTY | tile << 4*BLANK), childH, g+1, bound);
+                if(t.second || stopped(t.first))
+                {
+                    res = t;
+                    return true;
+                }
+                if(t.first < min) min = t.first;
+                return false;
+            }
+        };
+        bool done = [&]<unsigned... I>(std::integer_sequence<unsigned, I...>) {
+            return (tryMove(std::integral_constant<unsigned, I>{}) || ...);
+        }(std::make_integer_sequence<unsigned, moves.cnt>{});
+        generated += generatedHere;
+        return done? res: std::pair<unsigned, bool>{min, false};
+    }
+    // calls searchPacked with the blank and its previous position known only at run time
+    template<unsigned BLANK = 0, unsigned I = 0>
+    std::pair<unsigned, bool> searchPackedFrom(Direction* path, unsigned g, unsigned bound, unsigned prevEmptyPos)
+    {
+        constexpr MoveList moves = possibleMoves<K>[BLANK];
+        if constexpr(BLANK+1 < CELLS)
+            if(currentEmptyPos != BLANK)
+                return searchPackedFrom<BLANK+1>(path, g, bound, prevEmptyPos);
+        if constexpr(I == moves.cnt)
+            return searchPacked<BLANK, CELLS>(path, board.packed(), manhattan, g, bound);
+        else if(prevEmptyPos == moves.moves[I].newEmptyPos)
+            return searchPacked<BLANK, moves.moves[I].newEmptyPos>(path, board.packed(), manhattan, g, bound);
+        else return searchPackedFrom<BLANK, I+1>(path, g, bound, prevEmptyPos);
+    }
+    // the search from this node, which is g moves deep and is entered from prevEmptyPos (CELLS at the root)
+    std::pair<unsigned, bool> searchFrom(Direction* path, unsigned g, unsigned bound, unsigned prevEmptyPos)
+    {
+        if constexpr(CELLS*4 <= 64)
+            if(kind == Heuristic::MANHATTAN && !tt && weight == 1u << WEIGHT_SHIFT)
+                return searchPackedFrom(path, g, bound, prevEmptyPos);
+        return withHeuristic([&](auto h) {
+            return tt? search<h, true>(path, g, bound, prevEmptyPos): search<h, false>(path, g, bound, prevEmptyPos);
+        });
+    }
+    void memoizeManhattanDists()
+    {
+        for(unsigned tileNum=1; tileNum<CELLS; tileNum++)
+        {
+            unsigned target = targets[tileNum] = getTargetPosInd(tileNum);
+            for(unsigned cell=0; cell<CELLS; cell++)
+                manhattanDists[tileNum][cell] = std::abs(int(row(cell))-int(row(target))) + std::abs(int(col(cell))-int(col(target)));
+        }
+    }
+public:
+    State(const Board& b, unsigned emptyAtTheEnd, const HeuristicTables* tables = nullptr): emptyAtTheEnd(emptyAtTheEnd), kind(tables? tables->kind: Heuristic::MANHATTAN)
+    {
+        if(b.size() != K)
+            throw std::logic_error("board size mismatch");
+        for(unsigned i=0; i<CELLS; i++)
+            board.set(i, b[row(i)][col(i)]);
+        memoizeManhattanDists();
+        recalcTotalManhattan();
+        switch(kind)
+        {
+        case Heuristic::LINEAR_CONFLICT:
+            recalcLinearConflicts();
+            break;
+        case Heuristic::WALKING_DISTANCE:
+            rowsWd = tables->rowsWd.get();
+            colsWd = tables->colsWd.get();
+            if(rowsWd->sides() != K || rowsWd->goalLine() != row(emptyAtTheEnd) || colsWd->goalLine() != col(emptyAtTheEnd))
+                throw std::logic_error("walking distance tables were built for a different board size or goal");
+            recalcWalkingDistance();
+            break;
+        case Heuristic::PATTERN_DATABASE:
+            pdb = tables->pdb.get();
+            if(pdb->sides() != K || pdb->goalEmptyPos() != emptyAtTheEnd)
+                throw std::logic_error("pattern database was built for a different board size or goal");
+            recalcPatternDatabase();
+            break;
+        default:
+            break;
+        }
+    }
+    template<Heuristic H>
+    unsigned heuristic() const
     {
-        auto res = std::ldiv(ind, board.size());
-        return {(int)res.quot, (int)res.rem};
+        if constexpr(H == Heuristic::LINEAR_CONFLICT)
+            return manhattan + 2*linearConflicts;
+        else if constexpr(H == Heuristic::WALKING_DISTANCE)
+            return rowsWd->value(rowsWdIndex) + colsWd->value(colsWdIndex);
+        else if constexpr(H == Heuristic::PATTERN_DATABASE)
+            return pdbHeuristic;
+        else return manhattan;
     }
-    unsigned& at(std::size_t ind)
+    unsigned heuristic() const
     {
-        Position pos = getPosition(ind);
-        return board[pos.row][pos.col];
+        return withHeuristic([this](auto h) { return heuristic<h>(); });
     }
-    unsigned at(std::size_t ind) const
+    // the heuristic after moving the tile at `newEmpty` into the blank, without making the move
+    template<Heuristic H>
+    unsigned heuristicAfter(unsigned newEmpty) const
     {
-        Position pos = getPosition(ind);
-        return board[pos.row][pos.col];
+        unsigned tile = board.get(newEmpty);
+        if constexpr(H == Heuristic::LINEAR_CONFLICT)
+        {
+            bool horizontal = row(newEmpty) == row(currentEmptyPos);
+            unsigned lc = linearConflicts;
+            if(horizontal)
+            {
+                unsigned fromLine = col(newEmpty), toLine = col(currentEmptyPos), pos = row(newEmpty);
+                lc -= (*lineConflicts)[colCodes[fromLine]] + (*lineConflicts)[colCodes[toLine]];
+                lc += (*lineConflicts)[colCodes[fromLine] + (K - colDigit(tile, fromLine))*powers[pos]]
+                    + (*lineConflicts)[colCodes[toLine] - (K - colDigit(tile, toLine))*powers[pos]];
+            }
+            else
+            {
+                unsigned fromLine = row(newEmpty), toLine = row(currentEmptyPos), pos = col(newEmpty);
+                lc -= (*lineConflicts)[rowCodes[fromLine]] + (*lineConflicts)[rowCodes[toLine]];
+                lc += (*lineConflicts)[rowCodes[fromLine] + (K - rowDigit(tile, fromLine))*powers[pos]]
+                    + (*lineConflicts)[rowCodes[toLine] - (K - rowDigit(tile, toLine))*powers[pos]];
+            }
+            return manhattan + manhattanDists[tile][currentEmptyPos] - manhattanDists[tile][newEmpty] + 2*lc;
+        }
+        else if constexpr(H == Heuristic::WALKING_DISTANCE)
+        {
+            if(row(newEmpty) == row(currentEmptyPos))
+                return rowsWd->value(rowsWdIndex) + colsWd->value(colsWd->move(colsWdIndex, col(newEmpty) > col(currentEmptyPos), col(targets[tile])));
+            return rowsWd->value(rowsWd->move(rowsWdIndex, row(newEmpty) > row(currentEmptyPos), row(targets[tile]))) + colsWd->value(colsWdIndex);
+        }
+        else if constexpr(H == Heuristic::PATTERN_DATABASE)
+        {
+            std::size_t group = pdb->groupOf(tile);
+            if(group == pdb->groupsCnt()) return pdbHeuristic;
+            std::uint64_t index = pdbIndices[group], w = pdb->weightOf(tile);
+            return pdbHeuristic - pdb->value(group, index) + pdb->value(group, index + w*currentEmptyPos - w*newEmpty);
+        }
+        else return manhattan + manhattanDists[tile][currentEmptyPos] - manhattanDists[tile][newEmpty];
     }
-    std::size_t row(std::size_t ind) const
+    bool isSolvable() const
     {
-        return ind/board.size();
+        unsigned inversions = countInversions();
+        return (K%2 && !(inversions%2))
+            || (!(K%2) && (inversions+row(currentEmptyPos))%2 == row(emptyAtTheEnd)%2);
     }
-    std::size_t col(std::size_t ind) const
+    bool isSolved() const
     {
-        return ind%board.size();
+        return !manhattan;
     }
-    std::pair<unsigned, bool> search(std::vector<Direction>& st, unsigned g, unsigned bound)
+    // moves the tile at `newEmpty`, which should be next to the blank, into the blank
+    template<Heuristic H, bool HASH = true>
+    void slideInto(unsigned newEmpty)
     {
-        unsigned f = g + manhattan;
-        if(isSolved()) return {f, true};
-        if(f > bound) return {f, false};
-        unsigned min = -1;
-        for(int d=Direction::CNT-1; d>=0; d--)
-        //for(int d=0; d<Direction::CNT; d++)
-        {
-            Direction dir = static_cast<Direction>(d);
-            if(!st.empty() && dir == oposite(st.back()) || !makeMove(dir)) continue;
-            st.push_back(dir);
-            auto t = search(st, g+1, bound);
-            if(t.second) return {f, true};
-            if(t.first < min) min = t.first;
-            st.pop_back();
-            makeMove(oposite(dir));
-        }
-        return {min, false};
+        unsigned tile = board.slide(newEmpty, currentEmptyPos);
+        manhattan += manhattanDists[tile][currentEmptyPos] - manhattanDists[tile][newEmpty];
+        if constexpr(HASH)
+            hash ^= zobristKeys<K>[tile][newEmpty] ^ zobristKeys<K>[tile][currentEmptyPos];
+        if constexpr(H == Heuristic::LINEAR_CONFLICT)
+            updateLinearConflicts(tile, newEmpty, currentEmptyPos);
+        else if constexpr(H == Heuristic::WALKING_DISTANCE)
+            updateWalkingDistance(tile, newEmpty, currentEmptyPos);
+        else if constexpr(H == Heuristic::PATTERN_DATABASE)
+            updatePatternDatabase(tile, newEmpty, currentEmptyPos);
+        currentEmptyPos = newEmpty;
     }
-    void memoizeFinalPositions()
+    void slideInto(unsigned newEmpty)
     {
-        std::size_t k = board.size()*board.size();
-        m_finalPositions.reserve(k-1);
-        for(std::size_t tileNum=1; tileNum<k; tileNum++)
-            m_finalPositions.push_back(getPosition(getTargetPosInd(tileNum)));
+        withHeuristic([this, newEmpty](auto h) { slideInto<h>(newEmpty); });
     }
-public:
-    State(Board board, unsigned emptyAtTheEnd): board(std::move(board)), emptyAtTheEnd(emptyAtTheEnd)
+    bool makeMove(Direction d)
     {
-        memoizeFinalPositions();
-        recalcTotalManhattan();
+        int newEmpty = newEmptyPos<K>[currentEmptyPos][d];
+        if(newEmpty < 0) return false;
+        slideInto(newEmpty);
+        return true;
     }
-    bool isSolvable() const
+    // the root is expanded breadth-first into a frontier of subtrees and for each bound the workers search them
+    // in parallel; all of them stop as soon as one finds a solution, which is optimal (up to the weight) as any solution within the bound is
+    template<Heuristic H>
+    std::vector<Direction> solveParallel(const SolverOptions& options, SearchStats* stats) const
     {
-        unsigned inversions = countInversions();
-        return board.size()%2 && !(inversions%2)
-            || !(board.size()%2) && (inversions+currentEmptyPos.row)%2 == row(emptyAtTheEnd)%2;
+        const unsigned threads = options.threads;
+        std::vector<std::vector<Direction>> frontier{{}};
+        while(frontier.size() < FRONTIER_SIZE)
+        {
+            std::vector<std::vector<Direction>> next;
+            for(auto& path: frontier)
+            {
+                State node = *this;
+                unsigned prevEmptyPos = CELLS;
+                for(Direction d: path)
+                {
+                    prevEmptyPos = node.currentEmptyPos;
+                    node.template slideInto<H>(newEmptyPos<K>[node.currentEmptyPos][d]);
+                }
+                if(node.isSolved()) return path;
+                for(auto [dir, newEmpty]: possibleMoves<K>[node.currentEmptyPos])
+                    if(newEmpty != prevEmptyPos)
+                    {
+                        next.push_back(path);
+                        next.back().push_back(dir);
+                    }
+            }
+            if(next.size() <= frontier.size()) break; // the tree doesn't branch on 2x2 boards
+            frontier = std::move(next);
+        }
+        std::atomic<bool> stopped = false, found = false;
+        std::vector<Direction> solution;
+        std::vector<std::unique_ptr<TranspositionTable>> tts(threads); // one per worker, as the entries aren't atomic
+        if(options.ttBytes)
+            for(auto& tt: tts)
+                tt = std::make_unique<TranspositionTable>(options.ttBytes/threads);
+        for(unsigned bound = weighted(heuristic<H>());;)
+        {
+            auto start = std::chrono::steady_clock::now();
+            WorkStealingQueues queues(threads, frontier.size());
+            std::vector<unsigned> mins(threads, -1);
+            std::vector<unsigned long long> expandedCnt(threads), generatedCnt(threads);
+            std::vector<std::thread> workers;
+            for(unsigned t=0; t<threads; t++)
+                workers.emplace_back([&, t] {
+                    std::vector<Direction> st;
+                    while(auto task = queues.pop(t))
+                    {
+                        State node = *this;
+                        node.stop = &stopped;
+                        node.tt = tts[t].get();
+                        unsigned g = 0, f = 0, prevEmptyPos = CELLS;
+                        for(Direction d: frontier[*task])
+                        {
+                            prevEmptyPos = node.currentEmptyPos;
+                            node.template slideInto<H>(newEmptyPos<K>[node.currentEmptyPos][d]);
+                            if((f = ++g + node.weighted(node.template heuristic<H>())) > bound) break;
+                        }
+                        if(f <= bound)
+                        {
+                            st = frontier[*task];
+                            st.resize(std::max<std::size_t>(bound, st.size()));
+                            auto [newBound, solved] = node.searchFrom(st.data(), g, bound, prevEmptyPos);
+                            if(solved && !found.exchange(true))
+                            {
+                                st.resize(newBound);
+                                solution = std::move(st);
+                                stopped = true;
+                            }
+                            f = newBound;
+                        }
+                        if(f < mins[t]) mins[t] = f;
+                        expandedCnt[t] += node.expanded;
+                        generatedCnt[t] += node.generated;
+                    }
+                });
+            for(std::thread& worker: workers)
+                worker.join();
+            if(stats)
+                stats->addIteration(bound, std::accumulate(expandedCnt.begin(), expandedCnt.end(), 0ull),
+                                    std::accumulate(generatedCnt.begin(), generatedCnt.end(), 0ull),
+                                    std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+            if(stopped)
+            {
+                if(stats)
+                    for(auto& tt: tts)
+                        if(tt) stats->add(*tt);
+                if(!found)
+                    throw std::runtime_error("time limit exceeded");
+                return solution;
+            }
+            bound = *std::min_element(mins.begin(), mins.end());
+        }
     }
-    bool isSolved() const
+    struct AStarNode
     {
-        return !manhattan;
-    }
-    bool makeMove(Direction d)
+        PackedBoard<K> board;
+        std::uint64_t hash;
+        std::uint32_t parent;
+        std::uint16_t g, h;
+        std::uint8_t emptyPos, dir;
+        bool closed;
+    };
+    // the open list is a bucket of node indices for each f-value and the nodes are kept in an arena indexed by an open
+    // addressing hash table; returns no path if the nodes don't fit in options.astarBytes
+    template<Heuristic H>
+    std::optional<std::vector<Direction>> solveAStar(const SolverOptions& options, SearchStats* stats) const
     {
-        if(d == Direction::LEFT && currentEmptyPos.col == board.size()-1
-        || d == Direction::RIGHT && !currentEmptyPos.col
-        || d == Direction::UP && currentEmptyPos.row == board.size()-1
-        || d == Direction::DOWN && !currentEmptyPos.row
-          ) return false;
-        Position newEmptyPos = currentEmptyPos;
-        switch(d)
+        static constexpr std::uint32_t NONE = -1;
+        auto start = std::chrono::steady_clock::now();
+        State node = *this; // the expanded node, for the heuristic of its children
+        std::uint32_t loaded = NONE;
+        Arena<AStarNode> nodes;
+        std::vector<std::uint32_t> slots(1 << 12, NONE);
+        std::vector<std::vector<std::uint32_t>> open;
+        std::size_t openCnt = 0;
+        unsigned f = 0; // the bucket being scanned
+        unsigned long long expandedCnt = 0, generatedCnt = 0;
+        auto slotOf = [&](const PackedBoard<K>& board, std::uint64_t hash) -> std::uint32_t& {
+            for(std::size_t i = hash & (slots.size()-1);; i = (i+1) & (slots.size()-1))
+                if(slots[i] == NONE || (nodes[slots[i]].hash == hash && nodes[slots[i]].board == board))
+                    return slots[i];
+        };
+        // a weighted heuristic isn't consistent, so a child can go below the bucket being scanned; the scan goes back to it
+        auto push = [&](std::uint32_t i) {
+            unsigned childF = nodes[i].g + weighted(nodes[i].h);
+            if(childF >= open.size()) open.resize(childF+1);
+            open[childF].push_back(i);
+            openCnt++;
+            if(childF < f) f = childF;
+        };
+        auto record = [&]() {
+            if(stats) stats->addIteration(f, expandedCnt, generatedCnt, std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+        };
+        slotOf(board, hash) = nodes.add({board, hash, NONE, 0, static_cast<std::uint16_t>(heuristic<H>()),
+                                         static_cast<std::uint8_t>(currentEmptyPos), Direction::NONE, false});
+        push(0);
+        while(f < open.size())
         {
-        case Direction::LEFT:
-            newEmptyPos.col++;
-            break;
-        case Direction::RIGHT:
-            newEmptyPos.col--;
-            break;
-        case Direction::UP:
-            newEmptyPos.row++;
-            break;
-        case Direction::DOWN:
-            newEmptyPos.row--;
-            break;
-        default:
-            throw std::logic_error("bad direction");
+            if(open[f].empty())
+            {
+                f++;
+                continue;
+            }
+            std::uint32_t i = open[f].back();
+            open[f].pop_back();
+            openCnt--;
+            AStarNode& current = nodes[i];
+            if(current.closed || current.g + weighted(current.h) != f) continue; // reopened with a smaller g
+            if(current.parent != NONE && current.parent == loaded) // mostly the last child of the previous node is the next one
+                node.template slideInto<H>(current.emptyPos);
+            else node.load(current.board);
+            loaded = i;
+            if(node.isSolved())
+            {
+                std::vector<Direction> path;
+                for(std::uint32_t j=i; nodes[j].parent != NONE; j = nodes[j].parent)
+                    path.push_back(static_cast<Direction>(nodes[j].dir));
+                std::reverse(path.begin(), path.end());
+                record();
+                return path;
+            }
+            current.closed = true;
+            if(!(++expandedCnt & 0xFFFF) && std::chrono::steady_clock::now() >= deadline)
+                throw std::runtime_error("time limit exceeded");
+            for(auto [dir, newEmpty]: possibleMoves<K>[node.currentEmptyPos])
+            {
+                if(current.parent != NONE && newEmpty == nodes[current.parent].emptyPos) continue;
+                generatedCnt++;
+                PackedBoard<K> board = current.board;
+                unsigned tile = board.slide(newEmpty, node.currentEmptyPos);
+                std::uint64_t hash = node.hash ^ zobristKeys<K>[tile][newEmpty] ^ zobristKeys<K>[tile][node.currentEmptyPos];
+                std::uint16_t g = current.g + 1;
+                if(std::uint32_t& slot = slotOf(board, hash); slot != NONE)
+                {
+                    AStarNode& old = nodes[slot];
+                    if(old.g > g)
+                    {
+                        old.g = g;
+                        old.parent = i;
+                        old.dir = dir;
+                        old.closed = false;
+                        push(slot);
+                    }
+                    continue;
+                }
+                bool grow = 2*(nodes.size()+1) > slots.size(); // the old slots are freed after the new ones are filled
+                if(nodes.bytes() + nodes.bytesToAdd() + (grow? 3: 1)*slots.size()*sizeof(std::uint32_t) + (openCnt+1)*sizeof(std::uint32_t) > options.astarBytes)
+                {
+                    record();
+                    return std::nullopt;
+                }
+                std::uint32_t child = nodes.add({board, hash, i, g, static_cast<std::uint16_t>(node.template heuristicAfter<H>(newEmpty)),
+                                                 static_cast<std::uint8_t>(newEmpty), static_cast<std::uint8_t>(dir), false});
+                if(grow)
+                {
+                    std::vector<std::uint32_t>(2*slots.size(), NONE).swap(slots);
+                    for(std::uint32_t j=0; j<nodes.size(); j++)
+                        slotOf(nodes[j].board, nodes[j].hash) = j;
+                }
+                else slotOf(board, hash) = child;
+                push(child);
+            }
         }
-        std::swap(board[currentEmptyPos.row][currentEmptyPos.col], board[newEmptyPos.row][newEmptyPos.col]);
-        manhattan -= manhattanDist(board[currentEmptyPos.row][currentEmptyPos.col], newEmptyPos.row, newEmptyPos.col);
-        manhattan += manhattanDist(board[currentEmptyPos.row][currentEmptyPos.col], currentEmptyPos.row, currentEmptyPos.col);
-        currentEmptyPos = newEmptyPos;
-        return true;
+        throw std::logic_error("No solution");
     }
-    std::vector<Direction> solve()
+    std::vector<Direction> solve(const SolverOptions& options = {}, SearchStats* stats = nullptr)
     {
         /*if(!isSolvable())
             throw std::logic_error("No solution");*/
+        weight = std::lround(options.weight * (1 << WEIGHT_SHIFT));
+        if(options.timeLimit > 0)
+            deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.timeLimit));
+        if(options.astarBytes)
+        {
+            if(auto path = withHeuristic([&](auto h) { return solveAStar<h>(options, stats); }))
+                return *path;
+            if(stats) stats->astarOutOfMemory = true;
+        }
+        if(options.threads > 1)
+            return withHeuristic([&](auto h) { return solveParallel<h>(options, stats); });
+        std::unique_ptr<TranspositionTable> table;
+        if(options.ttBytes)
+            tt = (table = std::make_unique<TranspositionTable>(options.ttBytes)).get();
+        std::atomic<bool> timedOut = false;
+        if(options.timeLimit > 0)
+            stop = &timedOut;
         std::vector<Direction> st;
-        unsigned bound = manhattan;
-        for(;;)
+        bool found = false;
+        for(unsigned bound = weighted(heuristic());;)
         {
-            auto [newBound, found] = search(st, 0, bound);
-            if(found) break;
+            auto start = std::chrono::steady_clock::now();
+            expanded = generated = 0;
+            st.resize(bound);
+            auto [newBound, solved] = searchFrom(st.data(), 0, bound, CELLS);
+            if(stats)
+                stats->addIteration(bound, expanded, generated, std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+            if((found = solved))
+                st.resize(newBound);
+            if(found || timedOut) break;
             bound = newBound;
         }
+        if(stats && table) stats->add(*table);
+        tt = nullptr;
+        stop = nullptr;
+        if(!found)
+            throw std::runtime_error("time limit exceeded");
         return st;
     }
 };
@@ -209,8 +1439,7 @@ Board readBoard(std::istream& is, std::size_t k)
         for(std::size_t j=0; j<k; j++)
         {
             unsigned t;
-            is >> t;
-            if(t > maxTileNum)
+            if(!(is >> t) || t > maxTileNum)
                 throw std::logic_error("bad tile number");
             b[i].push_back(t);
         }
@@ -218,35 +1447,800 @@ Board readBoard(std::istream& is, std::size_t k)
     return b;
 }
 
-int main()
+struct Puzzle
+{
+    Board board;
+    unsigned emptyPos;
+};
+
+Puzzle readPuzzle(std::istream& is, std::size_t n)
 {
-    std::size_t n;
-    std::cin >> n;
     std::size_t k = sqrtLong(n+1);
+    if(n != k*k-1)
+        throw std::logic_error("n != k*k - 1");
+    int emptyPos;
+    if(!(is >> emptyPos))
+        throw std::logic_error("bad index of the blank");
+    if(emptyPos == -1) emptyPos = n;
+    if(emptyPos < 0 || static_cast<std::size_t>(emptyPos) > n)
+        throw std::logic_error("index out of the board");
+    return {readBoard(is, k), static_cast<unsigned>(emptyPos)};
+}
+
+// solves the rows and columns away from the blank's goal one at a time until a 3x3 corner is left, which is solved optimally;
+// the tiles of a line are placed by a breadth-first search over the positions of just the blank and the one or two tiles
+// being placed, which is fast on any board, but the solution isn't optimal
+class StagedSolver
+{
+    unsigned k, goalEmptyPos, emptyPos;
+    std::vector<unsigned> cells; // the tile in each cell
+    std::vector<bool> frozen;
+    unsigned top = 0, bottom, left = 0, right; // the unsolved part of the board
+    std::vector<Direction> path;
+    unsigned long long expanded = 0;
+    unsigned stages = 0;
+    unsigned targetOf(unsigned tileNum) const
+    {
+        return tileNum - (tileNum <= goalEmptyPos);
+    }
+    unsigned tileFor(unsigned target) const
+    {
+        return target + (target < goalEmptyPos);
+    }
+    bool isFree(unsigned cell) const
+    {
+        return cell/k >= top && cell/k <= bottom && cell%k >= left && cell%k <= right && !frozen[cell];
+    }
+    void moveBlank(unsigned to)
+    {
+        path.push_back(to == emptyPos+1? LEFT: to+1 == emptyPos? RIGHT: to == emptyPos+k? UP: DOWN);
+        std::swap(cells[emptyPos], cells[to]);
+        emptyPos = to;
+    }
+    // brings the tiles to their targets with the fewest moves of the blank in the free cells;
+    // a search state is the position of the blank and of each tile, 6 bits each
+    void place(const std::vector<unsigned>& tiles)
+    {
+        static constexpr std::uint32_t UNVISITED = -1;
+        auto posOf = [](std::uint32_t state, std::size_t i) -> unsigned { return state >> 6*i & 63; };
+        std::uint32_t start = emptyPos;
+        for(std::size_t i=0; i<tiles.size(); i++)
+            start |= std::uint32_t(std::find(cells.begin(), cells.end(), tiles[i]) - cells.begin()) << 6*(i+1);
+        std::vector<std::uint32_t> parent(std::size_t(1) << 6*(tiles.size()+1), UNVISITED), queue{start};
+        parent[start] = start;
+        for(std::size_t head=0; head<queue.size(); head++)
+        {
+            std::uint32_t state = queue[head];
+            bool placed = true;
+            for(std::size_t i=0; i<tiles.size() && placed; i++)
+                placed = posOf(state, i+1) == targetOf(tiles[i]);
+            if(placed)
+            {
+                std::vector<unsigned> blanks;
+                for(; state != start; state = parent[state])
+                    blanks.push_back(posOf(state, 0));
+                for(auto it=blanks.rbegin(); it!=blanks.rend(); ++it)
+                    moveBlank(*it);
+                stages++;
+                return;
+            }
+            expanded++;
+            unsigned blank = posOf(state, 0);
+            for(unsigned next: {blank-1, blank+1, blank-k, blank+k})
+            {
+                if(next >= k*k || ((next == blank-1 || next == blank+1) && next/k != blank/k) || !isFree(next)) continue;
+                std::uint32_t child = (state & ~63u) | next;
+                for(std::size_t i=1; i<=tiles.size(); i++)
+                    if(posOf(state, i) == next)
+                        child = (child & ~(63u << 6*i)) | blank << 6*i;
+                if(parent[child] == UNVISITED)
+                {
+                    parent[child] = state;
+                    queue.push_back(child);
+                }
+            }
+        }
+        throw std::logic_error("No solution");
+    }
+    // the corner is a smaller puzzle with the tiles numbered by their targets in it
+    template<unsigned K>
+    void solveCorner()
+    {
+        auto local = [&](unsigned cell) { return (cell/k-top)*K + cell%k-left; };
+        const unsigned goal = local(goalEmptyPos);
+        Board corner(K, std::vector<unsigned>(K));
+        for(unsigned r=top; r<=bottom; r++)
+            for(unsigned c=left; c<=right; c++)
+                if(unsigned tileNum = cells[r*k+c])
+                {
+                    unsigned target = local(targetOf(tileNum));
+                    corner[r-top][c-left] = target + (target < goal);
+                }
+        SearchStats stats;
+        for(Direction d: State<K>(corner, goal).solve({}, &stats))
+            moveBlank(d == LEFT? emptyPos+1: d == RIGHT? emptyPos-1: d == UP? emptyPos+k: emptyPos-k);
+        expanded += stats.expanded;
+        stages++;
+    }
+    // the last two tiles of a line are placed together, as placing one of them would block the other
+    void solveLine(const std::vector<unsigned>& targets)
+    {
+        for(std::size_t i=0; i<targets.size(); i++)
+        {
+            if(i+2 == targets.size())
+            {
+                place({tileFor(targets[i]), tileFor(targets[i+1])});
+                frozen[targets[i]] = frozen[targets[i+1]] = true;
+                break;
+            }
+            place({tileFor(targets[i])});
+            frozen[targets[i]] = true;
+        }
+    }
+public:
+    StagedSolver(const Board& b, unsigned goalEmptyPos): k(b.size()), goalEmptyPos(goalEmptyPos), cells(k*k), frozen(k*k), bottom(k-1), right(k-1)
+    {
+        if(k > 8)
+            throw std::logic_error("unsupported board size");
+        for(unsigned i=0; i<k*k; i++)
+            if(!(cells[i] = b[i/k][i%k]))
+                emptyPos = i;
+    }
+    std::vector<Direction> solve()
+    {
+        const unsigned goalRow = goalEmptyPos/k, goalCol = goalEmptyPos%k;
+        while(bottom-top > 2 || right-left > 2)
+        {
+            std::vector<unsigned> targets;
+            if(bottom-top > 2 && (bottom-top >= right-left || right-left <= 2))
+            {
+                unsigned r = goalRow != top? top: bottom;
+                for(unsigned c=left; c<=right; c++)
+                    targets.push_back(r*k+c);
+                solveLine(targets);
+                if(r == top) top++;
+                else bottom--;
+            }
+            else
+            {
+                unsigned c = goalCol != left? left: right;
+                for(unsigned r=top; r<=bottom; r++)
+                    targets.push_back(r*k+c);
+                solveLine(targets);
+                if(c == left) left++;
+                else right--;
+            }
+        }
+        if(k == 2) solveCorner<2>();
+        else solveCorner<3>();
+        return path;
+    }
+    unsigned long long expandedCnt() const
+    {
+        return expanded;
+    }
+    unsigned stagesCnt() const
+    {
+        return stages;
+    }
+};
+
+// returns no path if the puzzle is not solvable
+template<unsigned K>
+std::optional<std::vector<Direction>> solve(const Puzzle& puzzle, const HeuristicTables* tables, const SolverOptions& options, SearchStats& stats)
+{
+    State<K> initial(puzzle.board, puzzle.emptyPos, tables);
+    if(!initial.isSolvable())
+        return std::nullopt;
+    stats.lowerBound = initial.heuristic();
+    if(options.staged)
+    {
+        StagedSolver solver(puzzle.board, puzzle.emptyPos);
+        auto path = solver.solve();
+        stats.expanded += solver.expandedCnt();
+        stats.iterations += solver.stagesCnt();
+        return path;
+    }
+    return initial.solve(options, &stats);
+}
+
+std::optional<std::vector<Direction>> solve(const Puzzle& puzzle, const HeuristicTables* tables, const SolverOptions& options, SearchStats& stats)
+{
+    switch(puzzle.board.size())
+    {
+    case 2: return solve<2>(puzzle, tables, options, stats);
+    case 3: return solve<3>(puzzle, tables, options, stats);
+    case 4: return solve<4>(puzzle, tables, options, stats);
+    case 5: return solve<5>(puzzle, tables, options, stats);
+    case 6: return solve<6>(puzzle, tables, options, stats);
+    case 7: return solve<7>(puzzle, tables, options, stats);
+    case 8: return solve<8>(puzzle, tables, options, stats);
+    default:
+        throw std::logic_error("unsupported board size");
+    }
+}
+
+// the b for which a uniform tree of the given depth would have that many nodes below the root
+double effectiveBranchingFactor(unsigned long long nodes, std::size_t depth)
+{
+    if(!depth || !nodes) return 0;
+    double lo = 1, hi = std::max(2.0, double(nodes));
+    for(int i=0; i<100; i++)
+    {
+        double b = (lo+hi)/2, sum = 0, power = 1;
+        for(std::size_t d=0; d<depth && sum<nodes; d++)
+            sum += power *= b;
+        (sum < nodes? lo: hi) = b;
+    }
+    return lo;
+}
+
+double perSecond(unsigned long long cnt, double seconds)
+{
+    return seconds > 0? cnt/seconds: 0;
+}
+
+void printSearchStats(std::ostream& os, const SearchStats& stats, std::size_t depth)
+{
+    os << std::setw(4) << "iter" << std::setw(7) << "bound" << std::setw(15) << "expanded" << std::setw(15) << "generated"
+       << std::setw(8) << "growth" << std::setw(12) << "time" << std::setw(13) << "nodes/s" << '\n';
+    double seconds = 0;
+    for(std::size_t i=0; i<stats.perIteration.size(); i++)
+    {
+        const IterationStats& it = stats.perIteration[i];
+        os << std::setw(4) << i+1 << std::setw(7) << it.bound << std::setw(15) << it.expanded << std::setw(15) << it.generated;
+        if(i && stats.perIteration[i-1].expanded)
+            os << std::setw(8) << std::setprecision(2) << double(it.expanded)/stats.perIteration[i-1].expanded;
+        else os << std::setw(8) << '-';
+        os << std::setw(12) << std::setprecision(6) << it.seconds << std::setw(13) << std::setprecision(0) << perSecond(it.expanded, it.seconds) << '\n';
+        seconds += it.seconds;
+    }
+    os << "total: " << stats.expanded << " expanded, " << stats.generated << " generated, " << std::setprecision(0)
+       << perSecond(stats.expanded, seconds) << " nodes/s, effective branching factor " << std::setprecision(4)
+       << effectiveBranchingFactor(stats.generated, depth) << '\n';
+}
+
+void solveAndPrint(const Puzzle& puzzle, const HeuristicTables* tables, const SolverOptions& options, bool printStats)
+{
+    auto start = std::chrono::steady_clock::now();
+    SearchStats stats;
+    auto path = solve(puzzle, tables, options, stats);
+    auto end = std::chrono::steady_clock::now();
+    if(!path)
+    {
+        std::cout << "No solution\n";
+        return;
+    }
+    std::cout << path->size() << '\n';
+    for(Direction d: *path)
+        std::cout << strings[d] << '\n';
+    std::cerr.precision(6);
+    std::cerr << "elapsed time: " << std::fixed << std::chrono::duration<double>(end-start).count() << " s\n";
+    if(options.ttBytes)
+        std::cerr << "transposition table: " << stats.ttHits << " hits, " << stats.ttMisses << " misses\n";
+    if(stats.astarOutOfMemory)
+        std::cerr << "A* ran out of memory, solved with IDA*\n";
+    if((options.staged || options.weight > 1) && stats.lowerBound)
+        std::cerr << "at most " << std::setprecision(3) << double(path->size())/stats.lowerBound << " times optimal (lower bound "
+                  << stats.lowerBound << ")\n";
+    if(printStats)
+        printSearchStats(std::cerr, stats, path->size());
+}
+
+enum class OutputFormat
+{
+    JSON, CSV
+};
+
+std::string formatResult(OutputFormat format, std::size_t id, const Puzzle& puzzle, const std::optional<std::vector<Direction>>& path,
+                         const SearchStats& stats, double seconds)
+{
+    std::ostringstream os;
+    os.precision(6);
+    os << std::fixed;
+    std::size_t n = puzzle.board.size()*puzzle.board.size()-1;
+    if(format == OutputFormat::CSV)
+    {
+        os << id << ',' << n << ',' << (path? long(path->size()): -1) << ',' << stats.expanded << ',' << stats.generated << ','
+           << stats.iterations << ',' << seconds << ',';
+        if(path)
+            for(std::size_t i=0; i<path->size(); i++)
+                os << (i? " ": "") << strings[(*path)[i]];
+        os << ',';
+    }
+    else
+    {
+        os << "{\"id\":" << id << ",\"n\":" << n << ",\"solvable\":" << (path? "true": "false");
+        if(path)
+        {
+            os << ",\"length\":" << path->size() << ",\"path\":[";
+            for(std::size_t i=0; i<path->size(); i++)
+                os << (i? ",": "") << '"' << strings[(*path)[i]] << '"';
+            os << ']';
+        }
+        os << ",\"expanded\":" << stats.expanded << ",\"generated\":" << stats.generated << ",\"iterations\":" << stats.iterations << ",\"time\":" << seconds << '}';
+    }
+    os << '\n';
+    return os.str();
+}
+
+std::vector<Puzzle> readPuzzles(std::istream& is)
+{
+    std::vector<Puzzle> puzzles;
+    for(std::size_t n; is >> n;)
+        puzzles.push_back(readPuzzle(is, n));
+    return puzzles;
+}
+
+// a puzzle of the batch input, or why it couldn't be read
+struct BatchRecord
+{
+    std::optional<Puzzle> puzzle;
+    std::string error;
+};
+
+// reads the n of each record first and then its n+2 other numbers, so a record with a bad number is reported alone and
+// the next one starts where it should; only after a bad n the length of the record isn't known, and the next number
+// is read as the n of the next one
+std::vector<BatchRecord> readBatch(std::istream& is)
+{
+    std::vector<BatchRecord> records;
+    for(std::string token; is >> token;)
+    {
+        BatchRecord& record = records.emplace_back();
+        try
+        {
+            if(token.find_first_not_of("0123456789") != std::string::npos || token.size() > 9)
+                throw std::logic_error("bad n");
+            std::size_t n = std::stoul(token), k = sqrtLong(n+1);
+            if(n != k*k-1)
+                throw std::logic_error("n != k*k - 1");
+            std::string rest;
+            for(std::size_t i=0; i<n+2; i++)
+            {
+                if(!(is >> token))
+                    throw std::logic_error("the input ends in the middle of a puzzle");
+                rest += token + ' ';
+            }
+            std::istringstream values(rest);
+            record.puzzle = readPuzzle(values, n);
+        }
+        catch(const std::exception& e)
+        {
+            record.error = e.what();
+        }
+    }
+    return records;
+}
+
+// s as a JSON string, with the characters that cannot be in one as they are escaped
+std::string jsonString(const std::string& s)
+{
+    std::string res = "\"";
+    for(char c: s)
+        if(c == '"' || c == '\\')
+            res += {'\\', c};
+        else if(static_cast<unsigned char>(c) < 0x20)
+            res += {'\\', 'u', '0', '0', "0123456789abcdef"[c >> 4], "0123456789abcdef"[c & 15]};
+        else
+            res += c;
+    return res + '"';
+}
+
+// s as a CSV field, quoted with its quotes doubled if it has a separator, a quote or a line break
+std::string csvField(const std::string& s)
+{
+    if(s.find_first_of(",\"\r\n") == std::string::npos)
+        return s;
+    std::string res = "\"";
+    for(char c: s)
+        if(c == '"')
+            res += "\"\"";
+        else
+            res += c;
+    return res + '"';
+}
+
+std::string formatError(OutputFormat format, std::size_t id, const std::string& error)
+{
+    if(format == OutputFormat::CSV)
+        return std::to_string(id) + ",,,,,,,," + csvField(error) + '\n';
+    return "{\"id\":" + std::to_string(id) + ",\"error\":" + jsonString(error) + "}\n";
+}
+
+// the heuristic tables for one board size and goal, or why they couldn't be built
+struct SizeTables
+{
+    std::optional<HeuristicTables> tables;
+    std::string error;
+};
+
+// the board side and the goal position of the blank
+using SizeKey = std::pair<unsigned, unsigned>;
+
+// with several board sizes and goals, each one gets its own pattern database file <pdbFile>.<side>.<goal>
+std::string sizePdbFile(const char* pdbFile, SizeKey key, bool severalKeys)
+{
+    std::string file = pdbFile;
+    if(severalKeys)
+        file += "." + std::to_string(key.first) + "." + std::to_string(key.second);
+    return file;
+}
+
+SizeTables loadSizeTables(Heuristic heuristic, SizeKey key, const char* pdbFile, bool severalKeys)
+{
+    SizeTables res;
     try
     {
-        if(n != k*k-1)
-            throw std::logic_error("n != k*k - 1");
-        int emptyPos;
-        std::cin >> emptyPos;
-        if(emptyPos == -1) emptyPos = n;
-        if(emptyPos < 0 || static_cast<std::size_t>(emptyPos) > n)
-            throw std::logic_error("index out of the board");
-        Board b(readBoard(std::cin, k));
+        std::string file = pdbFile? sizePdbFile(pdbFile, key, severalKeys): "";
+        res.tables = loadHeuristicTables(heuristic, key.first, key.second, pdbFile? file.c_str(): nullptr);
+    }
+    catch(const std::exception& e)
+    {
+        res.error = e.what();
+    }
+    return res;
+}
+
+// the heuristic tables are built once for every board size and goal; the puzzles of a size the heuristic can't handle
+// get its error
+std::map<SizeKey, SizeTables> loadHeuristicTables(const std::vector<Puzzle>& puzzles, Heuristic heuristic, const char* pdbFile)
+{
+    std::map<SizeKey, SizeTables> tables;
+    for(const Puzzle& puzzle: puzzles)
+        tables.try_emplace({puzzle.board.size(), puzzle.emptyPos});
+    for(auto& [key, t]: tables)
+        t = loadSizeTables(heuristic, key, pdbFile, tables.size() > 1);
+    return tables;
+}
+
+// solves the puzzles on a pool of options.threads workers, one puzzle per worker, and prints the results in input order;
+// a record that can't be read or solved gets an error result of its own
+void solveBatch(std::istream& is, std::ostream& os, OutputFormat format, Heuristic heuristic, const char* pdbFile, SolverOptions options)
+{
+    std::vector<BatchRecord> records = readBatch(is);
+    std::vector<Puzzle> puzzles;
+    for(const BatchRecord& record: records)
+        if(record.puzzle)
+            puzzles.push_back(*record.puzzle);
+    auto tables = loadHeuristicTables(puzzles, heuristic, pdbFile);
+    const unsigned workersCnt = options.threads;
+    options.threads = 1;
+    std::vector<std::string> results(records.size());
+    std::vector<bool> ready(records.size());
+    std::mutex mutex;
+    std::condition_variable resultReady;
+    std::atomic<std::size_t> next = 0;
+    std::vector<std::thread> workers;
+    for(unsigned t=0; t<workersCnt; t++)
+        workers.emplace_back([&] {
+            for(std::size_t i; (i = next++) < records.size();)
+            {
+                std::string result;
+                if(!records[i].puzzle)
+                    result = formatError(format, i, records[i].error);
+                else if(const SizeTables& sizeTables = tables.at({records[i].puzzle->board.size(), records[i].puzzle->emptyPos}); !sizeTables.tables)
+                    result = formatError(format, i, sizeTables.error);
+                else try
+                {
+                    const Puzzle& puzzle = *records[i].puzzle;
+                    auto start = std::chrono::steady_clock::now();
+                    SearchStats stats;
+                    auto path = solve(puzzle, &*sizeTables.tables, options, stats);
+                    auto end = std::chrono::steady_clock::now();
+                    result = formatResult(format, i, puzzle, path, stats, std::chrono::duration<double>(end-start).count());
+                }
+                catch(const std::exception& e)
+                {
+                    result = formatError(format, i, e.what());
+                }
+                std::lock_guard lock(mutex);
+                results[i] = std::move(result);
+                ready[i] = true;
+                resultReady.notify_one();
+            }
+        });
+    if(format == OutputFormat::CSV)
+        os << "id,n,length,expanded,generated,iterations,time,path,error\n";
+    for(std::size_t i=0; i<records.size(); i++)
+    {
+        std::unique_lock lock(mutex);
+        resultReady.wait(lock, [&] { return ready[i]; });
+        os << results[i] << std::flush;
+        results[i].clear();
+    }
+    for(std::thread& worker: workers)
+        worker.join();
+}
+
+// the instances from the comment at the end of the file, then Korf's 100 random 15-puzzles (instances 6-105,
+// in the order of Korf 1985; their optimal solution lengths add up to 5305)
+const char BENCHMARK_INSTANCES[] = R"(
+8 5
+1 2 3
+4 5 6
+0 7 8
+
+8 -1
+6 5 1
+2 0 8
+3 4 7
+
+15 -1
+7 1 3 8
+2 6 4 12
+5 10 0 11
+9 13 14 15
+
+24 8
+8 20 7 1 9
+22 18 2 19 15
+11 0 14 3 13
+21 10 16 4 23
+17 6 12 5 24
+
+15 4
+15 14 7 13
+5 9 2 4
+6 10 11 8
+3 1 0 12
+
+15 0 14 13 15 7 11 12 9 5 6 0 2 1 4 8 10 3
+15 0 13 5 4 10 9 12 8 14 2 3 7 1 0 15 11 6
+15 0 14 7 8 2 13 11 10 4 9 12 5 0 3 6 1 15
+15 0 5 12 10 7 15 11 14 0 8 2 1 13 3 4 9 6
+15 0 4 7 14 13 10 3 9 12 11 5 6 15 1 2 8 0
+15 0 14 7 1 9 12 3 6 15 8 11 2 5 10 0 4 13
+15 0 2 11 15 5 13 4 6 7 12 8 10 1 9 3 14 0
+15 0 12 11 15 3 8 0 4 2 6 13 9 5 14 1 10 7
+15 0 3 14 9 11 5 4 8 2 13 12 6 7 10 1 15 0
+15 0 13 11 8 9 0 15 7 10 4 3 6 14 5 12 2 1
+15 0 5 9 13 14 6 3 7 12 10 8 4 0 15 2 11 1
+15 0 14 1 9 6 4 8 12 5 7 2 3 0 10 11 13 15
+15 0 3 6 5 2 10 0 15 14 1 4 13 12 9 8 11 7
+15 0 7 6 8 1 11 5 14 10 3 4 9 13 15 2 0 12
+15 0 13 11 4 12 1 8 9 15 6 5 14 2 7 3 10 0
+15 0 1 3 2 5 10 9 15 6 8 14 13 11 12 4 7 0
+15 0 15 14 0 4 11 1 6 13 7 5 8 9 3 2 10 12
+15 0 6 0 14 12 1 15 9 10 11 4 7 2 8 3 5 13
+15 0 7 11 8 3 14 0 6 15 1 4 13 9 5 12 2 10
+15 0 6 12 11 3 13 7 9 15 2 14 8 10 4 1 5 0
+15 0 12 8 14 6 11 4 7 0 5 1 10 15 3 13 9 2
+15 0 14 3 9 1 15 8 4 5 11 7 10 13 0 2 12 6
+15 0 10 9 3 11 0 13 2 14 5 6 4 7 8 15 1 12
+15 0 7 3 14 13 4 1 10 8 5 12 9 11 2 15 6 0
+15 0 11 4 2 7 1 0 10 15 6 9 14 8 3 13 5 12
+15 0 5 7 3 12 15 13 14 8 0 10 9 6 1 4 2 11
+15 0 14 1 8 15 2 6 0 3 9 12 10 13 4 7 5 11
+15 0 13 14 6 12 4 5 1 0 9 3 10 2 15 11 8 7
+15 0 9 8 0 2 15 1 4 14 3 10 7 5 11 13 6 12
+15 0 12 15 2 6 1 14 4 8 5 3 7 0 10 13 9 11
+15 0 12 8 15 13 1 0 5 4 6 3 2 11 9 7 14 10
+15 0 14 10 9 4 13 6 5 8 2 12 7 0 1 3 11 15
+15 0 14 3 5 15 11 6 13 9 0 10 2 12 4 1 7 8
+15 0 6 11 7 8 13 2 5 4 1 10 3 9 14 0 12 15
+15 0 1 6 12 14 3 2 15 8 4 5 13 9 0 7 11 10
+15 0 12 6 0 4 7 3 15 1 13 9 8 11 2 14 5 10
+15 0 8 1 7 12 11 0 10 5 9 15 6 13 14 2 3 4
+15 0 7 15 8 2 13 6 3 12 11 0 4 10 9 5 1 14
+15 0 9 0 4 10 1 14 15 3 12 6 5 7 11 13 8 2
+15 0 11 5 1 14 4 12 10 0 2 7 13 3 9 15 6 8
+15 0 8 13 10 9 11 3 15 6 0 1 2 14 12 5 4 7
+15 0 4 5 7 2 9 14 12 13 0 3 6 11 8 1 15 10
+15 0 11 15 14 13 1 9 10 4 3 6 2 12 7 5 8 0
+15 0 12 9 0 6 8 3 5 14 2 4 11 7 10 1 15 13
+15 0 3 14 9 7 12 15 0 4 1 8 5 6 11 10 2 13
+15 0 8 4 6 1 14 12 2 15 13 10 9 5 3 7 0 11
+15 0 6 10 1 14 15 8 3 5 13 0 2 7 4 9 11 12
+15 0 8 11 4 6 7 3 10 9 2 12 15 13 0 1 5 14
+15 0 10 0 2 4 5 1 6 12 11 13 9 7 15 3 14 8
+15 0 12 5 13 11 2 10 0 9 7 8 4 3 14 6 15 1
+15 0 10 2 8 4 15 0 1 14 11 13 3 6 9 7 5 12
+15 0 10 8 0 12 3 7 6 2 1 14 4 11 15 13 9 5
+15 0 14 9 12 13 15 4 8 10 0 2 1 7 3 11 5 6
+15 0 12 11 0 8 10 2 13 15 5 4 7 3 6 9 14 1
+15 0 13 8 14 3 9 1 0 7 15 5 4 10 12 2 6 11
+15 0 3 15 2 5 11 6 4 7 12 9 1 0 13 14 10 8
+15 0 5 11 6 9 4 13 12 0 8 2 15 10 1 7 3 14
+15 0 5 0 15 8 4 6 1 14 10 11 3 9 7 12 2 13
+15 0 15 14 6 7 10 1 0 11 12 8 4 9 2 5 13 3
+15 0 11 14 13 1 2 3 12 4 15 7 9 5 10 6 8 0
+15 0 6 13 3 2 11 9 5 10 1 7 12 14 8 4 0 15
+15 0 4 6 12 0 14 2 9 13 11 8 3 15 7 10 1 5
+15 0 8 10 9 11 14 1 7 15 13 4 0 12 6 2 5 3
+15 0 5 2 14 0 7 8 6 3 11 12 13 15 4 10 9 1
+15 0 7 8 3 2 10 12 4 6 11 13 5 15 0 1 9 14
+15 0 11 6 14 12 3 5 1 15 8 0 10 13 9 7 4 2
+15 0 7 1 2 4 8 3 6 11 10 15 0 5 14 12 13 9
+15 0 7 3 1 13 12 10 5 2 8 0 6 11 14 15 4 9
+15 0 6 0 5 15 1 14 4 9 2 13 8 10 11 12 7 3
+15 0 15 1 3 12 4 0 6 5 2 8 14 9 13 10 7 11
+15 0 5 7 0 11 12 1 9 10 15 6 2 3 8 4 13 14
+15 0 12 15 11 10 4 5 14 0 13 7 1 2 9 8 3 6
+15 0 6 14 10 5 15 8 7 1 3 4 2 0 12 9 11 13
+15 0 14 13 4 11 15 8 6 9 0 7 3 1 2 10 12 5
+15 0 14 4 0 10 6 5 1 3 9 2 13 15 12 7 8 11
+15 0 15 10 8 3 0 6 9 5 1 14 13 11 7 2 12 4
+15 0 0 13 2 4 12 14 6 9 15 1 10 3 11 5 8 7
+15 0 3 14 13 6 4 15 8 9 5 12 10 0 2 7 1 11
+15 0 0 1 9 7 11 13 5 3 14 12 4 2 8 6 10 15
+15 0 11 0 15 8 13 12 3 5 10 1 4 6 14 9 7 2
+15 0 13 0 9 12 11 6 3 5 15 8 1 10 4 14 2 7
+15 0 14 10 2 1 13 9 8 11 7 3 6 12 15 5 4 0
+15 0 12 3 9 1 4 5 10 2 6 11 15 0 14 7 13 8
+15 0 15 8 10 7 0 12 14 1 5 9 6 3 13 11 4 2
+15 0 4 7 13 10 1 2 9 6 12 8 14 5 3 0 11 15
+15 0 6 0 5 10 11 12 9 2 1 7 4 3 14 8 13 15
+15 0 9 5 11 10 13 0 2 1 8 6 14 12 4 7 3 15
+15 0 15 2 12 11 14 13 9 5 1 3 8 7 0 10 6 4
+15 0 11 1 7 4 10 13 3 8 9 14 0 15 6 5 2 12
+15 0 5 4 7 1 11 12 14 15 10 13 8 6 2 0 9 3
+15 0 9 7 5 2 14 15 12 10 11 3 6 1 8 13 0 4
+15 0 3 2 7 9 0 15 12 4 6 11 5 14 8 13 10 1
+15 0 13 9 14 6 12 8 1 2 3 4 0 7 5 10 11 15
+15 0 5 7 11 8 0 14 9 13 10 12 3 15 6 1 4 2
+15 0 4 3 6 13 7 15 9 0 10 5 8 11 2 12 1 14
+15 0 1 7 15 14 2 6 4 9 12 11 13 3 0 8 5 10
+15 0 9 14 5 7 8 15 1 2 10 4 13 6 12 0 11 3
+15 0 0 11 3 12 5 2 1 9 8 10 14 15 7 4 13 6
+15 0 7 15 4 0 10 9 2 5 12 11 13 6 1 3 14 8
+15 0 11 4 0 8 6 10 5 13 12 7 14 3 1 2 9 15
+)";
+
+// solves the built-in instances and those in the file (in the --batch input format) one after another
+// and prints a table of the search statistics; the tables of a board size are built when its first row comes, and
+// the rows of a size the heuristic can't handle are skipped, as are those that would need a pattern database over 4x4
+// generated first
+void runBenchmark(const char* file, Heuristic heuristic, const char* pdbFile, const SolverOptions& options)
+{
+    std::istringstream builtin(BENCHMARK_INSTANCES);
+    std::vector<Puzzle> puzzles = readPuzzles(builtin);
+    if(file)
+    {
+        std::ifstream is(file);
+        if(!is)
+            throw std::runtime_error(std::string("cannot open ") + file);
+        for(Puzzle& puzzle: readPuzzles(is))
+            puzzles.push_back(std::move(puzzle));
+    }
+    std::set<SizeKey> keys;
+    for(const Puzzle& puzzle: puzzles)
+        keys.insert({puzzle.board.size(), puzzle.emptyPos});
+    std::map<SizeKey, SizeTables> tables;
+    std::cout << std::setw(4) << '#' << std::setw(4) << 'n' << std::setw(8) << "length" << std::setw(15) << "expanded" << std::setw(15) << "generated"
+              << std::setw(6) << "iter" << std::setw(8) << "b*" << std::setw(12) << "time" << std::setw(13) << "nodes/s" << '\n';
+    SearchStats total;
+    double totalSeconds = 0;
+    std::size_t solved = 0, skipped = 0;
+    for(std::size_t i=0; i<puzzles.size(); i++)
+    {
+        const Puzzle& puzzle = puzzles[i];
+        SizeKey key{puzzle.board.size(), puzzle.emptyPos};
+        auto it = tables.find(key);
+        if(it == tables.end())
+        {
+            SizeTables t;
+            std::string file = pdbFile? sizePdbFile(pdbFile, key, keys.size() > 1): "";
+            if(heuristic == Heuristic::PATTERN_DATABASE && pdbFile && key.first > 4 && !fileExists(file.c_str()))
+                t.error = "no pattern database " + file + " (the benchmark doesn't generate them over 4x4)";
+            else t = loadSizeTables(heuristic, key, pdbFile, keys.size() > 1);
+            if(!t.tables)
+                std::cerr << "skipping the " << key.first*key.first-1 << "-puzzles with the blank at " << key.second << ": " << t.error << '\n';
+            it = tables.emplace(key, std::move(t)).first;
+        }
+        if(!it->second.tables)
+        {
+            std::cout << std::setw(4) << i+1 << std::setw(4) << key.first*key.first-1 << std::setw(8) << "skipped" << '\n';
+            skipped++;
+            continue;
+        }
+        SearchStats stats;
+        std::optional<std::vector<Direction>> path;
+        bool timedOut = false;
         auto start = std::chrono::steady_clock::now();
-        State initial(std::move(b), emptyPos);
-        if(!initial.isSolvable())
+        try
+        {
+            path = solve(puzzle, &*it->second.tables, options, stats);
+        }
+        catch(const std::runtime_error&)
+        {
+            timedOut = true;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        std::cout << std::setw(4) << i+1 << std::setw(4) << puzzle.board.size()*puzzle.board.size()-1 << std::setw(8);
+        if(timedOut) std::cout << "timeout";
+        else if(!path) std::cout << "none";
+        else std::cout << path->size();
+        std::cout << std::setw(15) << stats.expanded << std::setw(15) << stats.generated << std::setw(6) << stats.iterations << std::fixed << std::setw(8);
+        if(path) std::cout << std::setprecision(3) << effectiveBranchingFactor(stats.generated, path->size());
+        else std::cout << '-';
+        std::cout << std::setw(12) << std::setprecision(6) << seconds << std::setw(13) << std::setprecision(0) << perSecond(stats.expanded, seconds) << '\n';
+        solved += path.has_value();
+        total.expanded += stats.expanded;
+        total.generated += stats.generated;
+        totalSeconds += seconds;
+    }
+    std::cout << "solved " << solved << '/' << puzzles.size()-skipped;
+    if(skipped)
+        std::cout << " (" << skipped << " skipped)";
+    std::cout << ": " << total.expanded << " expanded, " << total.generated << " generated, "
+              << std::setprecision(6) << totalSeconds << " s, " << std::setprecision(0) << perSecond(total.expanded, totalSeconds) << " nodes/s\n";
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const char* pdbFile = nullptr;
+        std::optional<Heuristic> heuristic;
+        SolverOptions options;
+        bool batch = false, bench = false, printStats = false;
+        const char* benchFile = nullptr;
+        OutputFormat format = OutputFormat::JSON;
+        for(int i=1; i<argc; i++)
+            if(!std::strcmp(argv[i], "--pdb") && i+1 < argc)
+                pdbFile = argv[++i];
+            else if(!std::strcmp(argv[i], "--heuristic") && i+1 < argc)
+                heuristic = parseHeuristic(argv[++i]);
+            else if(!std::strcmp(argv[i], "--threads") && i+1 < argc)
+            {
+                options.threads = std::stoul(argv[++i]);
+                if(!options.threads)
+                    options.threads = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+            else if(!std::strcmp(argv[i], "--tt") && i+1 < argc)
+                options.ttBytes = std::stoull(argv[++i]) << 20;
+            else if(!std::strcmp(argv[i], "--time-limit") && i+1 < argc)
+                options.timeLimit = std::stod(argv[++i]);
+            else if(!std::strcmp(argv[i], "--weight") && i+1 < argc)
+            {
+                options.weight = std::stod(argv[++i]);
+                if(!(options.weight >= 1 && options.weight <= 100))
+                    throw std::invalid_argument("the weight should be between 1 and 100");
+            }
+            else if(!std::strcmp(argv[i], "--astar") && i+1 < argc)
+                options.astarBytes = std::stoull(argv[++i]) << 20;
+            else if(!std::strcmp(argv[i], "--staged"))
+                options.staged = true;
+            else if(!std::strcmp(argv[i], "--stats"))
+                printStats = true;
+            else if(!std::strcmp(argv[i], "--bench"))
+            {
+                bench = true;
+                if(i+1 < argc && std::strncmp(argv[i+1], "--", 2))
+                    benchFile = argv[++i];
+            }
+            else if(!std::strcmp(argv[i], "--batch"))
+                batch = true;
+            else if(!std::strcmp(argv[i], "--format") && i+1 < argc)
+            {
+                if(!std::strcmp(argv[++i], "json")) format = OutputFormat::JSON;
+                else if(!std::strcmp(argv[i], "csv")) format = OutputFormat::CSV;
+                else throw std::invalid_argument(std::string("unknown output format ") + argv[i]);
+            }
+            else throw std::invalid_argument(std::string("Usage: ") + *argv +
+                    " [--heuristic manhattan|linear-conflict|walking-distance|pdb] [--pdb <pattern database file>]"
+                    " [--threads <count, 0 for all cores>] [--tt <transposition table size in MB>]"
+                    " [--astar <memory limit in MB>] [--weight <w>] [--staged] [--time-limit <seconds>] [--stats] [--batch [--format json|csv] | --bench [<extra instances file>]]");
+        if(!heuristic)
+            heuristic = pdbFile? Heuristic::PATTERN_DATABASE: Heuristic::MANHATTAN;
+        if(bench)
+        {
+            if(!options.timeLimit)
+                options.timeLimit = 60;
+            runBenchmark(benchFile, *heuristic, pdbFile, options);
+            return 0;
+        }
+        if(batch)
         {
-            std::cout << "No solution\n";
+            solveBatch(std::cin, std::cout, format, *heuristic, pdbFile, options);
             return 0;
         }
-        std::vector<Direction> path = initial.solve();
-        auto end = std::chrono::steady_clock::now();
-        std::cout << path.size() << '\n';
-        for(Direction d: path)
-            std::cout << strings[d] << '\n';
-        std::cerr.precision(6);
-        std::cerr << "elapsed time: " << std::fixed << std::chrono::duration<double>(end-start).count() << " s\n";
+        std::size_t n;
+        std::cin >> n;
+        Puzzle puzzle = readPuzzle(std::cin, n);
+        HeuristicTables tables = loadHeuristicTables(*heuristic, puzzle.board.size(), puzzle.emptyPos, pdbFile);
+        solveAndPrint(puzzle, &tables, options, printStats);
     }
     catch(const std::exception& e)
     {
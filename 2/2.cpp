@@ -3,8 +3,24 @@
 #include <random>
 #include <chrono>
 #include <stdexcept>
+#include <exception>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <bit>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <charconv>
+#include <optional>
+#include <numeric>
+#include <limits>
+#include <unordered_map>
+#include <iomanip>
+#include <sys/resource.h>
 
 template<class T, class Generator>
 T randBetween(T a, T b, Generator&& g)
@@ -12,80 +28,298 @@ T randBetween(T a, T b, Generator&& g)
     return std::uniform_int_distribution<T>{a, b}(g);
 }
 
-class NQueens
+// a set of numbers below a given bound with O(1) insertion, removal and random access
+class IndexedSet
 {
-    std::vector<unsigned> rowOfQueen, queensInRow, queensInMainDiag, queensInAntidiag;
+    static constexpr unsigned ABSENT = -1;
+    std::vector<unsigned> items, posOf;
+public:
+    explicit IndexedSet(std::size_t bound): posOf(bound, ABSENT)
+    {}
+    void insert(unsigned x)
+    {
+        if(posOf[x] != ABSENT) return;
+        posOf[x] = items.size();
+        items.push_back(x);
+    }
+    void erase(unsigned x)
+    {
+        if(posOf[x] == ABSENT) return;
+        unsigned last = items.back();
+        items[posOf[last] = posOf[x]] = last;
+        items.pop_back();
+        posOf[x] = ABSENT;
+    }
+    void clear()
+    {
+        for(unsigned x: items)
+            posOf[x] = ABSENT;
+        items.clear();
+    }
+    std::size_t size() const
+    {
+        return items.size();
+    }
+    bool empty() const
+    {
+        return items.empty();
+    }
+    unsigned operator[](std::size_t i) const
+    {
+        return items[i];
+    }
+};
+
+enum class OutputFormat
+{
+    BOARD, ROWS, BINARY, NONE
+};
+
+// writes the queens given by the row of the queen in each column
+class QueensWriter
+{
+    static constexpr std::size_t CHUNK_SIZE = 1 << 20;
+    const std::vector<unsigned>& rowOfQueen;
+    unsigned size() const
+    {
+        return rowOfQueen.size();
+    }
+public:
+    explicit QueensWriter(const std::vector<unsigned>& rowOfQueen): rowOfQueen(rowOfQueen)
+    {}
+    // the rows are copies of an empty one with the queens patched in, written a chunk of about CHUNK_SIZE bytes at a time;
+    // the columns are bucketed by the rows of their queens first
+    void writeBoard(std::ostream& os) const
+    {
+        std::vector<unsigned> firstInRow(size()+1), colsByRow(size());
+        for(unsigned row: rowOfQueen)
+            firstInRow[row+1]++;
+        std::partial_sum(firstInRow.begin(), firstInRow.end(), firstInRow.begin());
+        std::vector<unsigned> next(firstInRow.begin(), firstInRow.end()-1);
+        for(unsigned col=0; col<size(); col++)
+            colsByRow[next[rowOfQueen[col]]++] = col;
+        std::string emptyRow(size(), '_'), chunk;
+        emptyRow += '\n';
+        chunk.reserve(std::max(CHUNK_SIZE, emptyRow.size()));
+        for(unsigned row=0; row<size(); row++)
+        {
+            std::size_t rowStart = chunk.size();
+            chunk += emptyRow;
+            for(unsigned i=firstInRow[row]; i<firstInRow[row+1]; i++)
+                chunk[rowStart + colsByRow[i]] = '*';
+            if(chunk.size() + emptyRow.size() > CHUNK_SIZE)
+            {
+                os.write(chunk.data(), chunk.size());
+                chunk.clear();
+            }
+        }
+        os.write(chunk.data(), chunk.size());
+    }
+    // the row of the queen in each column, as text on one line or as native-endian 32-bit integers
+    void writeRows(std::ostream& os, bool binary) const
+    {
+        if(binary)
+        {
+            os.write(reinterpret_cast<const char*>(rowOfQueen.data()), rowOfQueen.size()*sizeof(unsigned));
+            return;
+        }
+        std::string chunk(CHUNK_SIZE, ' ');
+        std::size_t length = 0;
+        for(unsigned col=0; col<size(); col++)
+        {
+            if(length + 12 > chunk.size())
+            {
+                os.write(chunk.data(), length);
+                length = 0;
+            }
+            length = std::to_chars(chunk.data()+length, chunk.data()+chunk.size(), rowOfQueen[col]).ptr - chunk.data();
+            chunk[length++] = col+1 < size()? ' ': '\n';
+        }
+        os.write(chunk.data(), length);
+    }
+    void write(std::ostream& os, OutputFormat format) const
+    {
+        if(format == OutputFormat::BOARD) writeBoard(os);
+        else if(format != OutputFormat::NONE) writeRows(os, format == OutputFormat::BINARY);
+        os.flush();
+    }
+};
+
+// min-conflicts search: a random variable with conflicts gets the value with the fewest of them until none is left;
+// the Constraints policy counts what the variables take so that the conflicts of a value are O(1), and provides
+//     std::size_t variables() const, unsigned domain() const
+//     unsigned conflicts(unsigned var, unsigned value, unsigned current) const - of var if it had value instead of current
+//     unsigned preferredValue(std::mt19937&) const - a value likely to have no conflicts, or domain() if there is none
+//     void place(std::vector<unsigned>& values, std::mt19937&) - an initial assignment, counted from scratch
+//     void move(unsigned var, unsigned from, unsigned to, const std::vector<unsigned>& values, F&& gained) - counts
+//         the move and calls gained with every other variable that may have got a conflict from it
+template<class Constraints>
+class MinConflicts
+{
+    static constexpr unsigned VALUE_SAMPLES = 16;
+protected:
+    Constraints constraints;
+    std::vector<unsigned> values;
+private:
+    // has every variable with conflicts; the ones that lose them are removed when picked
+    IndexedSet conflictedVars;
     std::mt19937 mt;
+    std::uint32_t walkBelow; // a move is a random walk if a draw of mt is below it
     bool isSolved = false;
-    void addQueen(unsigned row, unsigned col, int cnt = 1)
+    unsigned long long steps = 0;
+    unsigned conflictsCnt(unsigned var) const
     {
-        queensInRow[row] += cnt;
-        queensInMainDiag[size()-1+row-col] += cnt;
-        queensInAntidiag[row+col] += cnt;
+        return constraints.conflicts(var, values[var], values[var]);
     }
-    unsigned getRowWithMinConflict(unsigned col)
+    // scans a small domain; in a big one the candidates are some preferred values and some random ones,
+    // and ties are broken uniformly (reservoir sampling)
+    unsigned getValueWithMinConflict(unsigned var)
     {
-        unsigned min = -1;
-        std::vector<unsigned> bestRows;
-        for(unsigned row=0; row<size(); row++)
+        const unsigned domain = constraints.domain();
+        const bool sample = domain > 2*VALUE_SAMPLES;
+        unsigned min = -1, best = values[var], ties = 0;
+        for(unsigned i=0; i<(sample? 2*VALUE_SAMPLES: domain); i++)
         {
-            unsigned conflicts = conflictsCnt(row, col);
+            unsigned value = !sample? i: i < VALUE_SAMPLES? constraints.preferredValue(mt): domain;
+            if(value == domain)
+                value = randBetween<unsigned>(0, domain-1, mt);
+            unsigned conflicts = constraints.conflicts(var, value, values[var]);
             if(conflicts < min)
             {
                 min = conflicts;
-                bestRows.clear();
+                ties = 0;
             }
-            if(conflicts == min)
-                bestRows.push_back(row);
+            if(conflicts == min && !randBetween<unsigned>(0, ties++, mt))
+                best = value;
+            if(sample && !min) break;
         }
-        return bestRows[randBetween<unsigned>(0, bestRows.size()-1, mt)];
-    }
-    unsigned conflictsCnt(unsigned row, unsigned col) const
-    {
-        return queensInRow[row]+queensInMainDiag[size()-1+row-col]+queensInAntidiag[row+col]-3*hasQueen(row, col);
+        return best;
     }
-    unsigned getColWithMaxConflict()
+    // a random variable with conflicts, or variables() if there are none
+    unsigned getConflictedVar()
     {
-        unsigned max = 0;
-        std::vector<unsigned> worstCols;
-        for(unsigned col=0; col<size(); col++)
+        for(;;)
         {
-            unsigned conflicts = conflictsCnt(rowOfQueen[col], col);
-            if(conflicts > max)
+            if(conflictedVars.empty())
             {
-                max = conflicts;
-                worstCols.clear();
+                for(unsigned var=0; var<values.size(); var++)
+                    if(conflictsCnt(var))
+                        conflictedVars.insert(var);
+                if(conflictedVars.empty())
+                {
+                    isSolved = true;
+                    return values.size();
+                }
             }
-            if(conflicts == max)
-                worstCols.push_back(col);
+            unsigned var = conflictedVars[randBetween<std::size_t>(0, conflictedVars.size()-1, mt)];
+            if(conflictsCnt(var)) return var;
+            conflictedVars.erase(var);
         }
-        if(!max) isSolved = true;
-        return worstCols[randBetween<unsigned>(0, worstCols.size()-1, mt)];
+    }
+    void moveVar(unsigned var, unsigned to)
+    {
+        unsigned from = values[var];
+        values[var] = to;
+        constraints.move(var, from, to, values, [this](unsigned other) {
+            conflictedVars.insert(other);
+        });
+        if(conflictsCnt(var))
+            conflictedVars.insert(var);
     }
 public:
-    NQueens(std::size_t n, unsigned long seed = 1): queensInRow(n), queensInMainDiag(2*n-1), queensInAntidiag(2*n-1), mt(seed)
+    // with walkProbability a conflicted variable takes a random value instead, which gets it out of the local minima
+    // that sampling doesn't
+    MinConflicts(Constraints constraints, unsigned long seed, double walkProbability = 0):
+        constraints(std::move(constraints)), values(this->constraints.variables()), conflictedVars(values.size()), mt(seed),
+        walkBelow(walkProbability * std::mt19937::max())
     {
-        if(n==2 || n==3)
-            throw std::logic_error("no solution");
-        rowOfQueen.reserve(n);
-        placeQueens();
+        restart();
+    }
+    void restart()
+    {
+        conflictedVars.clear();
+        isSolved = false;
+        constraints.place(values, mt);
+    }
+    unsigned long long stepsCnt() const
+    {
+        return steps;
+    }
+    // gives up after maxSteps moves or once cancel is set
+    bool solve(unsigned maxSteps, const std::atomic<bool>* cancel = nullptr)
+    {
+        for(;; maxSteps--)
+        {
+            unsigned var = getConflictedVar();
+            if(isSolved) return true;
+            if(!maxSteps || (cancel && cancel->load(std::memory_order_relaxed))) return false;
+            steps++;
+            if(walkBelow && mt() < walkBelow)
+                moveVar(var, randBetween<unsigned>(0, constraints.domain()-1, mt));
+            else
+                moveVar(var, getValueWithMinConflict(var));
+        }
+    }
+};
+
+// the queens are the variables and their rows the values
+class QueenConstraints
+{
+    std::vector<unsigned> queensInRow, queensInMainDiag, queensInAntidiag;
+    // the xor of the columns of the queens in each line, which is the column of the queen if it is alone there
+    std::vector<unsigned> colsInRow, colsInMainDiag, colsInAntidiag;
+    IndexedSet emptyRows; // as the queens are mostly one per row, the rows without conflicts are among these
+    void addQueen(unsigned row, unsigned col, int cnt = 1)
+    {
+        if(!(queensInRow[row] += cnt)) emptyRows.insert(row);
+        else emptyRows.erase(row);
+        queensInMainDiag[size()-1+row-col] += cnt;
+        queensInAntidiag[row+col] += cnt;
+        colsInRow[row] ^= col;
+        colsInMainDiag[size()-1+row-col] ^= col;
+        colsInAntidiag[row+col] ^= col;
     }
     unsigned size() const
     {
         return queensInRow.size();
     }
-    bool hasQueen(unsigned row, unsigned col) const
+public:
+    explicit QueenConstraints(std::size_t n): queensInRow(n), queensInMainDiag(2*n-1), queensInAntidiag(2*n-1),
+                                              colsInRow(n), colsInMainDiag(2*n-1), colsInAntidiag(2*n-1), emptyRows(n)
     {
-        return row == rowOfQueen[col];
+        if(n==2 || n==3)
+            throw std::logic_error("no solution");
     }
-    void placeQueens()
+    std::size_t variables() const
+    {
+        return size();
+    }
+    unsigned domain() const
+    {
+        return size();
+    }
+    unsigned conflicts(unsigned col, unsigned row, unsigned current) const
+    {
+        return queensInRow[row]+queensInMainDiag[size()-1+row-col]+queensInAntidiag[row+col]-3*(row == current);
+    }
+    unsigned preferredValue(std::mt19937& mt) const
+    {
+        return !emptyRows.empty()? emptyRows[randBetween<std::size_t>(0, emptyRows.size()-1, mt)]: size();
+    }
+    void place(std::vector<unsigned>& rowOfQueen, std::mt19937&)
     {
         std::fill(queensInRow.begin(), queensInRow.end(), 0);
         std::fill(queensInMainDiag.begin(), queensInMainDiag.end(), 0);
         std::fill(queensInAntidiag.begin(), queensInAntidiag.end(), 0);
+        std::fill(colsInRow.begin(), colsInRow.end(), 0);
+        std::fill(colsInMainDiag.begin(), colsInMainDiag.end(), 0);
+        std::fill(colsInAntidiag.begin(), colsInAntidiag.end(), 0);
+        emptyRows.clear();
+        for(unsigned row=0; row<size(); row++)
+            emptyRows.insert(row);
         /*for(unsigned col=0; col<size(); col++)
             addQueen(rowOfQueen[col] = getRowWithMinConflict(col), col);*/
-        unsigned col = 1;
+        unsigned col = size() > 1;
         for(unsigned row=0; row<size(); row++)
         {
             rowOfQueen[col] = row;
@@ -95,46 +329,630 @@ public:
                 col = 0;
         }
     }
-    bool solve(unsigned maxSteps)
+    // a queen that was alone in a line the moved one enters gets a conflict; those that weren't have had one
+    template<class F>
+    void move(unsigned inCol, unsigned fromRow, unsigned toRow, const std::vector<unsigned>&, F&& gained)
+    {
+        addQueen(fromRow, inCol, -1);
+        if(queensInRow[toRow] == 1) gained(colsInRow[toRow]);
+        if(queensInMainDiag[size()-1+toRow-inCol] == 1) gained(colsInMainDiag[size()-1+toRow-inCol]);
+        if(queensInAntidiag[toRow+inCol] == 1) gained(colsInAntidiag[toRow+inCol]);
+        addQueen(toRow, inCol);
+    }
+};
+
+class NQueens: public MinConflicts<QueenConstraints>
+{
+public:
+    NQueens(std::size_t n, unsigned long seed = 1): MinConflicts(QueenConstraints(n), seed)
+    {}
+    unsigned size() const
+    {
+        return values.size();
+    }
+    bool hasQueen(unsigned row, unsigned col) const
+    {
+        return row == values[col];
+    }
+    void placeQueens()
     {
-        while(maxSteps--)
+        restart();
+    }
+    void write(std::ostream& os, OutputFormat format) const
+    {
+        QueensWriter(values).write(os, format);
+    }
+    friend std::ostream& operator<<(std::ostream& os, const NQueens& obj)
+    {
+        QueensWriter(obj.values).writeBoard(os);
+        return os;
+    }
+};
+
+// an undirected graph as the neighbours of every vertex one after another
+struct Graph
+{
+    std::vector<std::size_t> firstNeighbour;
+    std::vector<unsigned> neighbours;
+    std::size_t vertices() const
+    {
+        return firstNeighbour.size()-1;
+    }
+    // edges between random vertices of different classes of a hidden colouring, so that the graph has one
+    static Graph randomColorable(std::size_t vertices, std::size_t edges, unsigned colors, std::mt19937& mt)
+    {
+        if(colors < 2 || vertices < colors)
+            throw std::invalid_argument("a colorable graph needs at least 2 colors and as many vertices");
+        std::vector<unsigned> hiddenColor(vertices);
+        for(unsigned v=0; v<vertices; v++)
+            hiddenColor[v] = v % colors;
+        std::vector<std::pair<unsigned, unsigned>> ends;
+        ends.reserve(edges);
+        while(ends.size() < edges)
         {
-            unsigned col = getColWithMaxConflict();
-            moveQueen(col, rowOfQueen[col], getRowWithMinConflict(col));
-            if(isSolved) return true;
+            unsigned u = randBetween<unsigned>(0, vertices-1, mt), v = randBetween<unsigned>(0, vertices-1, mt);
+            if(hiddenColor[u] != hiddenColor[v])
+                ends.emplace_back(u, v);
+        }
+        Graph g;
+        g.firstNeighbour.assign(vertices+1, 0);
+        for(auto [u, v]: ends)
+        {
+            g.firstNeighbour[u+1]++;
+            g.firstNeighbour[v+1]++;
+        }
+        std::partial_sum(g.firstNeighbour.begin(), g.firstNeighbour.end(), g.firstNeighbour.begin());
+        g.neighbours.resize(2*edges);
+        std::vector<std::size_t> next(g.firstNeighbour.begin(), g.firstNeighbour.end()-1);
+        for(auto [u, v]: ends)
+        {
+            g.neighbours[next[u]++] = v;
+            g.neighbours[next[v]++] = u;
         }
-        return false;
+        return g;
     }
-    void moveQueen(unsigned inCol, unsigned fromRow, unsigned toRow)
+};
+
+// the vertices are the variables and their colors the values; every vertex counts the neighbours of each color,
+// so a move costs the degree of the vertex
+class ColoringConstraints
+{
+    const Graph& graph;
+    unsigned colors;
+    std::vector<unsigned> neighboursWithColor;
+public:
+    ColoringConstraints(const Graph& graph, unsigned colors): graph(graph), colors(colors),
+                                                             neighboursWithColor(graph.vertices()*colors)
+    {}
+    std::size_t variables() const
     {
-        addQueen(fromRow, inCol, -1);
-        rowOfQueen[inCol] = toRow;
-        addQueen(toRow, inCol);
+        return graph.vertices();
     }
-    friend std::ostream& operator<<(std::ostream& os, const NQueens& obj)
+    unsigned domain() const
+    {
+        return colors;
+    }
+    unsigned conflicts(unsigned v, unsigned color, unsigned) const
+    {
+        return neighboursWithColor[std::size_t(v)*colors+color];
+    }
+    unsigned preferredValue(std::mt19937&) const
+    {
+        return colors;
+    }
+    void place(std::vector<unsigned>& colorOf, std::mt19937& mt)
     {
-        for(unsigned i=0; i<obj.size(); i++)
+        std::fill(neighboursWithColor.begin(), neighboursWithColor.end(), 0);
+        for(unsigned& color: colorOf)
+            color = randBetween<unsigned>(0, colors-1, mt);
+        for(unsigned v=0; v<graph.vertices(); v++)
+            for(std::size_t i=graph.firstNeighbour[v]; i<graph.firstNeighbour[v+1]; i++)
+                neighboursWithColor[std::size_t(graph.neighbours[i])*colors+colorOf[v]]++;
+    }
+    template<class F>
+    void move(unsigned v, unsigned from, unsigned to, const std::vector<unsigned>& colorOf, F&& gained)
+    {
+        for(std::size_t i=graph.firstNeighbour[v]; i<graph.firstNeighbour[v+1]; i++)
+        {
+            unsigned u = graph.neighbours[i];
+            neighboursWithColor[std::size_t(u)*colors+from]--;
+            neighboursWithColor[std::size_t(u)*colors+to]++;
+            if(colorOf[u] == to)
+                gained(u);
+        }
+    }
+};
+
+// min-conflicts on a random colorable graph for up to 10 steps per vertex, reporting how fast they go
+void benchmarkColoring(std::size_t vertices, std::size_t edges, unsigned colors, unsigned long seed)
+{
+    constexpr double WALK_PROBABILITY = 0.02;
+    std::mt19937 mt(seed);
+    Graph graph = Graph::randomColorable(vertices, edges, colors, mt);
+    MinConflicts<ColoringConstraints> coloring(ColoringConstraints(graph, colors), seed, WALK_PROBABILITY);
+    auto start = std::chrono::steady_clock::now();
+    bool solved = coloring.solve(10*vertices);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    std::cout << vertices << " vertices, " << edges << " edges, " << colors << " colors: "
+              << (solved? "solved": "not solved") << " after " << coloring.stepsCnt() << " steps in " << seconds << " s, "
+              << std::fixed << std::setprecision(0) << coloring.stepsCnt()/seconds << " steps/s\n";
+}
+
+// the numbers of queens on the diagonals in counters of the given type; they are small, so the excess over the
+// largest value of the type is kept in a map for the rare diagonal that overflows
+template<class Counter>
+class DiagonalCounters
+{
+    static constexpr Counter SATURATED = std::numeric_limits<Counter>::max();
+    std::vector<Counter> counters;
+    std::unordered_map<unsigned, unsigned> excess;
+public:
+    explicit DiagonalCounters(std::size_t cnt): counters(cnt)
+    {}
+    unsigned operator[](unsigned i) const
+    {
+        if(counters[i] != SATURATED) return counters[i];
+        auto it = excess.find(i);
+        return SATURATED + (it != excess.end()? it->second: 0);
+    }
+    void increment(unsigned i)
+    {
+        if(counters[i] != SATURATED) counters[i]++;
+        else excess[i]++;
+    }
+    void decrement(unsigned i)
+    {
+        if(counters[i] == SATURATED)
+            if(auto it = excess.find(i); it != excess.end())
+            {
+                if(!--it->second) excess.erase(it);
+                return;
+            }
+        counters[i]--;
+    }
+    void clear()
+    {
+        std::fill(counters.begin(), counters.end(), 0);
+        excess.clear();
+    }
+};
+
+// min-conflicts over permutations: every row and column has exactly one queen, so only the diagonals are counted and
+// a move swaps the rows of two queens; with 8-bit counters it takes about 8 bytes per queen and a list of the attacked
+// columns, which is refilled by a sweep over the board when it runs out before the collisions do
+template<class Counter = std::uint8_t>
+class CompactNQueens
+{
+    static constexpr unsigned PARTNER_SAMPLES = 16, RANDOM_COLS = 32, MAX_TRIES = 64;
+    std::vector<unsigned> rowOfQueen;
+    DiagonalCounters<Counter> queensInMainDiag, queensInAntidiag;
+    std::vector<unsigned> attackedCols;
+    std::vector<bool> isListed;
+    std::mt19937 mt;
+    unsigned long long collisions = 0, steps = 0; // the queens beyond the first one on every diagonal
+    // both return by how much the collisions change
+    unsigned addQueen(unsigned col)
+    {
+        unsigned row = rowOfQueen[col], added = (queensInMainDiag[size()-1+row-col] > 0) + (queensInAntidiag[row+col] > 0);
+        queensInMainDiag.increment(size()-1+row-col);
+        queensInAntidiag.increment(row+col);
+        return added;
+    }
+    unsigned removeQueen(unsigned col)
+    {
+        unsigned row = rowOfQueen[col];
+        queensInMainDiag.decrement(size()-1+row-col);
+        queensInAntidiag.decrement(row+col);
+        return (queensInMainDiag[size()-1+row-col] > 0) + (queensInAntidiag[row+col] > 0);
+    }
+    bool isAttacked(unsigned col) const
+    {
+        unsigned row = rowOfQueen[col];
+        return queensInMainDiag[size()-1+row-col] > 1 || queensInAntidiag[row+col] > 1;
+    }
+    void list(unsigned col)
+    {
+        if(isListed[col]) return;
+        isListed[col] = true;
+        attackedCols.push_back(col);
+    }
+    // by how much swapping the rows of the queens in the two columns changes the collisions
+    int swapDelta(unsigned a, unsigned b)
+    {
+        if(a == b) return 0;
+        int removed = removeQueen(a) + removeQueen(b);
+        std::swap(rowOfQueen[a], rowOfQueen[b]);
+        int added = addQueen(a) + addQueen(b);
+        removeQueen(a);
+        removeQueen(b);
+        std::swap(rowOfQueen[a], rowOfQueen[b]);
+        addQueen(a);
+        addQueen(b);
+        return added - removed;
+    }
+    void swapQueens(unsigned a, unsigned b, int delta)
+    {
+        removeQueen(a);
+        removeQueen(b);
+        std::swap(rowOfQueen[a], rowOfQueen[b]);
+        addQueen(a);
+        addQueen(b);
+        collisions += delta;
+    }
+    // a random attacked column, or size() if there are none
+    unsigned getAttackedCol()
+    {
+        for(;;)
+        {
+            if(attackedCols.empty())
+            {
+                if(!collisions) return size();
+                for(unsigned col=0; col<size(); col++)
+                    if(isAttacked(col))
+                        list(col);
+            }
+            std::size_t i = randBetween<std::size_t>(0, attackedCols.size()-1, mt);
+            unsigned col = attackedCols[i];
+            attackedCols[i] = attackedCols.back();
+            attackedCols.pop_back();
+            isListed[col] = false;
+            if(isAttacked(col)) return col;
+        }
+    }
+    // n if a board of that size can be solved; checked before any of it is allocated, as 2*n-1 wraps around for n=0
+    static std::size_t solvableSize(std::size_t n)
+    {
+        if(!n)
+            throw std::invalid_argument("the board must have at least one cell");
+        if(n==2 || n==3)
+            throw std::logic_error("no solution");
+        return n;
+    }
+public:
+    CompactNQueens(std::size_t n, unsigned long seed = 1): rowOfQueen(solvableSize(n)), queensInMainDiag(2*n-1),
+                                                           queensInAntidiag(2*n-1), isListed(n), mt(seed)
+    {
+        placeQueens();
+    }
+    unsigned size() const
+    {
+        return rowOfQueen.size();
+    }
+    bool hasQueen(unsigned row, unsigned col) const
+    {
+        return row == rowOfQueen[col];
+    }
+    unsigned long long stepsCnt() const
+    {
+        return steps;
+    }
+    // QS4 of Sosic and Gu: a random permutation built column by column, where each queen but the last few tries up to
+    // MAX_TRIES of the remaining rows for one on free diagonals, which leaves only a few collisions to repair
+    void placeQueens()
+    {
+        std::iota(rowOfQueen.begin(), rowOfQueen.end(), 0);
+        queensInMainDiag.clear();
+        queensInAntidiag.clear();
+        attackedCols.clear();
+        std::fill(isListed.begin(), isListed.end(), false);
+        collisions = 0;
+        const unsigned greedyCols = size() > RANDOM_COLS? size()-RANDOM_COLS: 0;
+        for(unsigned col=0; col<size(); col++)
         {
-            for(unsigned j=0; j<obj.size(); j++)
-                os << (obj.hasQueen(i, j)? '*': '_');
-            os << '\n';
+            for(unsigned tries=1; ; tries++)
+            {
+                std::swap(rowOfQueen[col], rowOfQueen[randBetween<unsigned>(col, size()-1, mt)]);
+                if(col >= greedyCols || tries == MAX_TRIES ||
+                   (!queensInMainDiag[size()-1+rowOfQueen[col]-col] && !queensInAntidiag[rowOfQueen[col]+col]))
+                    break;
+            }
+            collisions += addQueen(col);
         }
+    }
+    // an attacked queen swaps rows with the best of some random ones if that doesn't add collisions;
+    // gives up after maxSteps moves or once cancel is set
+    bool solve(unsigned maxSteps, const std::atomic<bool>* cancel = nullptr)
+    {
+        for(;; maxSteps--)
+        {
+            unsigned col = getAttackedCol();
+            if(col == size()) return true;
+            if(!maxSteps || (cancel && cancel->load(std::memory_order_relaxed))) return false;
+            steps++;
+            unsigned best = col;
+            int min = 1;
+            for(unsigned i=0; i<PARTNER_SAMPLES && min >= 0; i++)
+            {
+                unsigned other = randBetween<unsigned>(0, size()-1, mt);
+                if(int delta = swapDelta(col, other); other != col && delta < min)
+                {
+                    min = delta;
+                    best = other;
+                }
+            }
+            if(best != col)
+                swapQueens(col, best, min);
+            if(isAttacked(col)) list(col);
+            if(isAttacked(best)) list(best);
+        }
+    }
+    void write(std::ostream& os, OutputFormat format) const
+    {
+        QueensWriter(rowOfQueen).write(os, format);
+    }
+    friend std::ostream& operator<<(std::ostream& os, const CompactNQueens& obj)
+    {
+        QueensWriter(obj.rowOfQueen).writeBoard(os);
         return os;
     }
 };
 
-int main() try
+// counts all solutions by backtracking row by row with the attacked columns and diagonals as bitmasks;
+// only the solutions with the first queen in the left half (and the second one in the left half if the first is in the
+// middle) are searched and their mirror images are counted too, and the placements of the first two queens are the tasks
+// shared by the threads
+class SolutionCounter
+{
+    struct Task
+    {
+        unsigned first, second;
+    };
+    unsigned n;
+    std::uint32_t all;
+    std::vector<Task> tasks;
+    unsigned long long countFrom(std::uint32_t cols, std::uint32_t diag, std::uint32_t antidiag) const
+    {
+        if(cols == all) return 1;
+        unsigned long long cnt = 0;
+        for(std::uint32_t free = all & ~(cols | diag | antidiag); free; free &= free-1)
+        {
+            std::uint32_t bit = free & -free;
+            cnt += countFrom(cols | bit, (diag | bit) << 1, (antidiag | bit) >> 1);
+        }
+        return cnt;
+    }
+    // appends the solutions and their mirror images to out, the column of the queen in each row per line
+    unsigned long long listFrom(std::vector<unsigned>& queens, std::uint32_t cols, std::uint32_t diag, std::uint32_t antidiag, std::string& out) const
+    {
+        if(cols == all)
+        {
+            for(bool mirror: {false, true})
+                for(unsigned row=0; row<n; row++)
+                {
+                    out += std::to_string(mirror? n-1-queens[row]: queens[row]);
+                    out += row+1 < n? ' ': '\n';
+                }
+            return 2;
+        }
+        unsigned long long cnt = 0;
+        for(std::uint32_t free = all & ~(cols | diag | antidiag); free; free &= free-1)
+        {
+            std::uint32_t bit = free & -free;
+            queens.push_back(std::countr_zero(bit));
+            cnt += listFrom(queens, cols | bit, (diag | bit) << 1, (antidiag | bit) >> 1, out);
+            queens.pop_back();
+        }
+        return cnt;
+    }
+public:
+    explicit SolutionCounter(unsigned n): n(n), all(n == 32? -1: (1u << n) - 1)
+    {
+        if(!n || n > 32)
+            throw std::logic_error("solutions can be counted for 1 to 32 queens");
+        for(unsigned first=0; first<(n+1)/2; first++)
+            for(unsigned second=0; second<(first == n/2 && n%2? first: n); second++)
+                if(second+1 < first || second > first+1)
+                    tasks.push_back({first, second});
+    }
+    // prints the solutions to os if it isn't null
+    unsigned long long count(unsigned threads, std::ostream* os = nullptr) const
+    {
+        if(n == 1)
+        {
+            if(os) *os << "0\n";
+            return 1;
+        }
+        std::atomic<std::size_t> next = 0;
+        std::atomic<unsigned long long> total = 0;
+        std::mutex outMutex;
+        std::vector<std::thread> workers;
+        for(unsigned t=0; t<threads; t++)
+            workers.emplace_back([&] {
+                std::vector<unsigned> queens;
+                std::string out;
+                for(std::size_t i; (i = next++) < tasks.size();)
+                {
+                    std::uint32_t first = 1u << tasks[i].first, second = 1u << tasks[i].second;
+                    std::uint32_t cols = first | second, diag = (first << 1 | second) << 1, antidiag = (first >> 1 | second) >> 1;
+                    if(!os)
+                    {
+                        total += 2*countFrom(cols, diag, antidiag);
+                        continue;
+                    }
+                    queens = {tasks[i].first, tasks[i].second};
+                    total += listFrom(queens, cols, diag, antidiag, out);
+                    std::lock_guard lock(outMutex);
+                    *os << out;
+                    out.clear();
+                }
+            });
+        for(std::thread& worker: workers)
+            worker.join();
+        return total;
+    }
+};
+
+template<class Board>
+struct Winner
+{
+    Board board;
+    unsigned long seed;
+    unsigned restarts;
+};
+
+// every thread restarts its own board with its own seed (seed, seed+1, ...) after 2n steps without a solution;
+// the first one to solve it stops the rest; so does the first one to fail, whose exception is rethrown after all stop
+template<class Board>
+Winner<Board> solveRacing(std::size_t n, unsigned long seed, unsigned threads)
 {
+    std::atomic<bool> done = false;
+    std::optional<Winner<Board>> winner;
+    std::exception_ptr error;
+    auto run = [&](unsigned long seed) {
+        try
+        {
+            Board own(n, seed);
+            unsigned restarts = 0;
+            for(; !own.solve(2*n, &done); restarts++)
+            {
+                if(done.load(std::memory_order_relaxed)) return;
+                own.placeQueens();
+            }
+            if(!done.exchange(true))
+                winner.emplace(std::move(own), seed, restarts);
+        }
+        catch(...)
+        {
+            if(!done.exchange(true))
+                error = std::current_exception();
+        }
+    };
+    if(threads <= 1)
+        run(seed);
+    else
+    {
+        std::vector<std::jthread> workers;
+        for(unsigned t=0; t<threads; t++)
+            workers.emplace_back(run, seed+t);
+    }
+    if(error)
+        std::rethrow_exception(error);
+    return std::move(*winner);
+}
+
+// the peak resident set size of the process so far, in KB
+long peakRssKB()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// solves N = 10^3, 10^4, ... up to maxN and 4 more than each of them once for each of a fixed set of seeds and prints a
+// CSV line per N; the knight pattern that NQueens starts from is a solution unless N mod 6 is 2 or 3, so 10^k is the easy
+// case for it and 10^k+4 the hard one; the peak RSS is of the whole process, so it is that of the biggest N so far
+template<class Board>
+void runBenchmark(std::size_t maxN, unsigned threads)
+{
+    constexpr unsigned long SEEDS = 10;
+    auto median = [](const auto& sorted) { return sorted[sorted.size()/2]; };
+    auto p95 = [](const auto& sorted) { return sorted[(95*sorted.size()+99)/100-1]; };
+    std::cout << "n,seeds,median_time,p95_time,median_steps,p95_steps,median_restarts,p95_restarts,steps_per_s,peak_rss_kb\n";
+    for(std::size_t power=1000; power<=maxN; power*=10)
+        for(std::size_t n: {power, power+4})
+        {
+            std::vector<double> times;
+            std::vector<unsigned long long> steps, restarts;
+            unsigned long long totalSteps = 0;
+            double totalTime = 0;
+            for(unsigned long seed=1; seed<=SEEDS; seed++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                Winner<Board> winner = solveRacing<Board>(n, seed, threads);
+                times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+                steps.push_back(winner.board.stepsCnt());
+                totalTime += times.back();
+                totalSteps += steps.back();
+                restarts.push_back(winner.restarts);
+            }
+            std::sort(times.begin(), times.end());
+            std::sort(steps.begin(), steps.end());
+            std::sort(restarts.begin(), restarts.end());
+            std::cout << n << ',' << SEEDS << ',' << std::fixed << std::setprecision(6) << median(times) << ',' << p95(times) << ','
+                      << median(steps) << ',' << p95(steps) << ',' << median(restarts) << ',' << p95(restarts) << ','
+                      << std::setprecision(0) << totalSteps/totalTime << ',' << peakRssKB() << std::endl;
+        }
+}
+
+int main(int argc, char** argv) try
+{
+    bool countAll = false, printAll = false, compact = false;
+    std::size_t benchMaxN = 0;
+    OutputFormat format = OutputFormat::BOARD;
+    unsigned threads = 0; // all cores when counting, one when solving; --threads 0 is all cores for both
+    unsigned long seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::size_t coloringSize = 0, coloringEdges = 0;
+    unsigned coloringColors = 0;
+    for(int i=1; i<argc; i++)
+        if(!std::strcmp(argv[i], "--count"))
+            countAll = true;
+        else if(!std::strcmp(argv[i], "--print-all"))
+            countAll = printAll = true;
+        else if(!std::strcmp(argv[i], "--threads") && i+1 < argc)
+        {
+            threads = std::stoul(argv[++i]);
+            if(!threads)
+                threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        else if(!std::strcmp(argv[i], "--coloring") && i+3 < argc)
+        {
+            coloringSize = std::stoull(argv[++i]);
+            coloringEdges = std::stoull(argv[++i]);
+            coloringColors = std::stoul(argv[++i]);
+        }
+        else if(!std::strcmp(argv[i], "--bench"))
+        {
+            benchMaxN = 10'000'000;
+            if(i+1 < argc && std::isdigit(static_cast<unsigned char>(*argv[i+1])))
+                benchMaxN = std::stoull(argv[++i]);
+        }
+        else if(!std::strcmp(argv[i], "--compact"))
+            compact = true;
+        else if(!std::strcmp(argv[i], "--seed") && i+1 < argc)
+            seed = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--output") && i+1 < argc)
+        {
+            if(!std::strcmp(argv[++i], "board")) format = OutputFormat::BOARD;
+            else if(!std::strcmp(argv[i], "rows")) format = OutputFormat::ROWS;
+            else if(!std::strcmp(argv[i], "binary")) format = OutputFormat::BINARY;
+            else if(!std::strcmp(argv[i], "none")) format = OutputFormat::NONE;
+            else throw std::invalid_argument(std::string("unknown output format ") + argv[i]);
+        }
+        else throw std::invalid_argument(std::string("Usage: ") + *argv +
+                " [--output board|rows|binary|none] [--count | --print-all] [--threads <count>] [--seed <seed>] [--compact]"
+                " [--coloring <vertices> <edges> <colors> | --bench [<max N>]]");
+    if(coloringSize)
+    {
+        benchmarkColoring(coloringSize, coloringEdges, coloringColors, seed);
+        return 0;
+    }
+    if(benchMaxN)
+    {
+        if(compact) runBenchmark<CompactNQueens<>>(benchMaxN, threads);
+        else runBenchmark<NQueens>(benchMaxN, threads);
+        return 0;
+    }
     std::size_t n;
     std::cin >> n;
     auto start = std::chrono::steady_clock::now();
-    NQueens board(n, std::chrono::system_clock::now().time_since_epoch().count());
-    while(!board.solve(2*n))
-        board.placeQueens();
-    auto end = std::chrono::steady_clock::now();
-    //std::cout << board;
-    std::cerr.precision(6);
-    std::cerr << "elapsed time: " << std::fixed << std::chrono::duration<double>(end-start).count() << " s\n";
+    if(countAll)
+    {
+        unsigned long long cnt = SolutionCounter(n).count(threads? threads: std::max(std::thread::hardware_concurrency(), 1u), printAll? &std::cout: nullptr);
+        auto end = std::chrono::steady_clock::now();
+        (printAll? std::cerr: std::cout) << cnt << " solutions\n";
+        std::cerr.precision(6);
+        std::cerr << "elapsed time: " << std::fixed << std::chrono::duration<double>(end-start).count() << " s\n";
+        return 0;
+    }
+    auto report = [&](const auto& winner) {
+        auto end = std::chrono::steady_clock::now();
+        winner.board.write(std::cout, format);
+        std::cerr << "seed " << winner.seed << " won after " << winner.board.stepsCnt() << " steps and " << winner.restarts << " restarts\n";
+        std::cerr.precision(6);
+        std::cerr << "elapsed time: " << std::fixed << std::chrono::duration<double>(end-start).count() << " s\n";
+    };
+    if(compact) report(solveRacing<CompactNQueens<>>(n, seed, threads));
+    else report(solveRacing<NQueens>(n, seed, threads));
 }
 catch(const std::exception& e)
 {
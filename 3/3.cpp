@@ -8,6 +8,30 @@
 #include <algorithm>
 #include <utility>
 #include <iomanip>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <type_traits>
+#include <cstdint>
+#include <limits>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <barrier>
+#include <optional>
+#include <charconv>
+#include <fstream>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef TSP_GATHER_LENGTH
+#include <immintrin.h>
+#endif
 
 constexpr double      MIN_COORDINATE = 0,
                       MAX_COORDINATE = 1000,
@@ -15,7 +39,22 @@ constexpr double      MIN_COORDINATE = 0,
                       KEEP_PARENT_PROBABILITY = 0.3;
 constexpr std::size_t POPULATION_SIZE = 20000,
                       ITERATIONS = 2000,
-                      MAX_POINTS = 1000;
+                      MAX_MATRIX_BYTES = std::size_t(1) << 30,
+                      NEAREST_NEIGHBOURS = 10,
+                      OR_OPT_SEGMENT = 3,
+                      CITIES_PER_CELL = 2,
+                      TOURNAMENT_SIZE = 3,
+                      MIGRATION_INTERVAL = 50,
+                      MIGRANTS = 2;
+constexpr double      MIN_IMPROVEMENT = 1e-7;
+
+// the type of the stored distances; float halves the memory and doubles the SIMD width;
+// TSP_GATHER_LENGTH (with AVX2 enabled) sums the lengths of paths with gathers, which pays off only where gathers are fast
+#ifdef TSP_FLOAT_DISTANCES
+using Distance = float;
+#else
+using Distance = double;
+#endif
 
 double sqr(double n)
 {
@@ -30,6 +69,33 @@ struct Point
     }
 };
 
+// how the distance between two cities is computed from their coordinates: as it is, or as one of the TSPLIB
+// edge weight types, which round it to an integer
+enum class Metric
+{
+    Euclidean,
+    RoundedEuclidean, // EUC_2D
+    CeilEuclidean,    // CEIL_2D
+    PseudoEuclidean   // ATT
+};
+double metricDistance(const Point& a, const Point& b, Metric metric)
+{
+    switch(metric)
+    {
+    case Metric::RoundedEuclidean:
+        return std::floor(a.distance(b)+0.5);
+    case Metric::CeilEuclidean:
+        return std::ceil(a.distance(b));
+    case Metric::PseudoEuclidean:
+    {
+        double r = a.distance(b)/std::sqrt(10.0), t = std::floor(r+0.5);
+        return t < r? t+1: t;
+    }
+    default:
+        return a.distance(b);
+    }
+}
+
 template<class Generator>
 std::vector<Point> randPoints(std::size_t cnt, double min, double max, Generator&& gen)
 {
@@ -41,176 +107,1057 @@ std::vector<Point> randPoints(std::size_t cnt, double min, double max, Generator
     return res;
 }
 
+// the contents of a file, mapped into memory instead of read
+class MappedFile
+{
+    const char* data = nullptr;
+    std::size_t length = 0;
+public:
+    explicit MappedFile(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            throw std::runtime_error("cannot open " + path);
+        struct stat info;
+        if(fstat(fd, &info) == 0 && (length = info.st_size))
+        {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped != MAP_FAILED)
+            {
+                madvise(mapped, length, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(mapped);
+            }
+        }
+        close(fd);
+        if(length && !data)
+            throw std::runtime_error("cannot map " + path);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+        if(data)
+            munmap(const_cast<char*>(data), length);
+    }
+    const char* begin() const
+    {
+        return data;
+    }
+    const char* end() const
+    {
+        return data+length;
+    }
+};
+
+// the lines of a file one at a time, without their line breaks (\n or \r\n), and the errors in them with their numbers
+class LineReader
+{
+    MappedFile file;
+    std::string path;
+    const char* next;
+    std::size_t number = 0;
+public:
+    explicit LineReader(const std::string& path): file(path), path(path), next(file.begin()) {}
+    bool read(std::string_view& line)
+    {
+        if(next == file.end())
+            return false;
+        const char* end = std::find(next, file.end(), '\n');
+        line = {next, static_cast<std::size_t>(end-next)};
+        if(!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        next = end == file.end()? end: end+1;
+        number++;
+        return true;
+    }
+    std::size_t lines() const // an upper bound of the lines left, counted fast
+    {
+        return std::count(next, file.end(), '\n') + 1;
+    }
+    std::runtime_error error(const std::string& what) const
+    {
+        return std::runtime_error(path + ":" + std::to_string(number) + ": " + what);
+    }
+};
+
+std::string_view trim(std::string_view s)
+{
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+// the number at the start of s, which is removed from it with the spaces before it
+template<class T>
+T parseNumber(std::string_view& s, const LineReader& reader)
+{
+    s = trim(s);
+    T value;
+    auto [end, error] = std::from_chars(s.data(), s.data()+s.size(), value);
+    if(error != std::errc())
+        throw reader.error("a number was expected");
+    s.remove_prefix(end-s.data());
+    return value;
+}
+
+// the cities of a TSPLIB .tsp file with 2D coordinates, and the metric its EDGE_WEIGHT_TYPE stands for
+std::vector<Point> loadTSPLIB(const std::string& path, Metric& metric)
+{
+    LineReader reader(path);
+    std::string_view line;
+    std::size_t dimension = 0;
+    for(;;)
+    {
+        if(!reader.read(line))
+            throw reader.error("NODE_COORD_SECTION was expected");
+        line = trim(line);
+        std::string_view key = trim(line.substr(0, line.find(':'))), value;
+        if(key == "NODE_COORD_SECTION") break;
+        if(line.find(':') != std::string_view::npos)
+            value = trim(line.substr(line.find(':')+1));
+        if(key == "DIMENSION")
+            dimension = parseNumber<std::size_t>(value, reader);
+        else if(key == "TYPE" && value != "TSP")
+            throw reader.error("only symmetric TSP instances are supported");
+        else if(key == "EDGE_WEIGHT_TYPE")
+        {
+            if(value == "EUC_2D") metric = Metric::RoundedEuclidean;
+            else if(value == "CEIL_2D") metric = Metric::CeilEuclidean;
+            else if(value == "ATT") metric = Metric::PseudoEuclidean;
+            else throw reader.error("only the edge weight types EUC_2D, CEIL_2D and ATT are supported");
+        }
+    }
+    if(!dimension)
+        throw reader.error("DIMENSION was expected before NODE_COORD_SECTION");
+    std::vector<Point> cities(dimension);
+    std::vector<bool> isGiven(dimension);
+    std::size_t given = 0;
+    while(reader.read(line) && (line = trim(line)) != "EOF")
+    {
+        if(line.empty()) continue;
+        std::size_t id = parseNumber<std::size_t>(line, reader);
+        if(id < 1 || id > dimension || isGiven[id-1])
+            throw reader.error("the city numbers are to be 1, ..., DIMENSION, each once");
+        cities[id-1].x = parseNumber<double>(line, reader);
+        cities[id-1].y = parseNumber<double>(line, reader);
+        isGiven[id-1] = true;
+        given++;
+    }
+    if(given != dimension)
+        throw reader.error("the coordinates of " + std::to_string(dimension-given) + " cities are missing");
+    return cities;
+}
+// the cities of a file with a line "x,y" for each, like UK_TSP/uk12_xy.csv, whose distances are not rounded,
+// or of a TSPLIB file if its name ends with .tsp; metric is set to the one they are to be measured with
+std::vector<Point> loadCities(const std::string& path, Metric& metric)
+{
+    metric = Metric::Euclidean;
+    if(path.size() >= 4 && path.compare(path.size()-4, 4, ".tsp") == 0)
+        return loadTSPLIB(path, metric);
+    LineReader reader(path);
+    std::vector<Point> cities;
+    cities.reserve(reader.lines());
+    std::string_view line;
+    while(reader.read(line))
+    {
+        if(trim(line).empty()) continue;
+        double x = parseNumber<double>(line, reader);
+        line = trim(line);
+        if(line.empty() || line.front() != ',')
+            throw reader.error("a comma was expected");
+        line.remove_prefix(1);
+        double y = parseNumber<double>(line, reader);
+        if(!trim(line).empty())
+            throw reader.error("the end of the line was expected");
+        cities.push_back({x, y});
+    }
+    return cities;
+}
+// a name for each city, one per line, like UK_TSP/uk12_name.csv
+std::vector<std::string> loadNames(const std::string& path, std::size_t cities)
+{
+    LineReader reader(path);
+    std::vector<std::string> names;
+    names.reserve(cities);
+    std::string_view line;
+    while(reader.read(line))
+        names.emplace_back(trim(line));
+    while(!names.empty() && names.back().empty()) // the empty lines at the end
+        names.pop_back();
+    if(names.size() != cities)
+        throw std::runtime_error(path + ": " + std::to_string(names.size()) + " names for " + std::to_string(cities) + " cities");
+    return names;
+}
+
+// the distances are in a full matrix with its rows aligned to cache lines, unless it would take more than
+// MAX_MATRIX_BYTES; then they are computed from the coordinates when needed
 class TSP_Map
 {
-    std::vector<std::vector<double>> distsSqr;
-    void initDistances(const std::vector<Point>& cities)
+    static constexpr std::size_t ALIGNMENT = 64;
+    struct AlignedDelete
+    {
+        void operator()(Distance* p) const
+        {
+            ::operator delete[](p, std::align_val_t(ALIGNMENT));
+        }
+    };
+    std::vector<Point> points;
+    Metric metric;
+    std::size_t stride = 0; // the row length, padded to a multiple of ALIGNMENT bytes
+    std::unique_ptr<Distance[], AlignedDelete> dists;
+    void initDistances()
+    {
+        constexpr std::size_t perLine = ALIGNMENT/sizeof(Distance);
+        stride = (cities()+perLine-1)/perLine*perLine;
+        if(stride*cities()*sizeof(Distance) > MAX_MATRIX_BYTES)
+            return;
+        dists.reset(new(std::align_val_t(ALIGNMENT)) Distance[stride*cities()]);
+        for(std::size_t i=0; i<cities(); i++)
+            for(std::size_t j=0; j<cities(); j++)
+                dists[i*stride+j] = metricDistance(points[i], points[j], metric);
+    }
+#ifdef TSP_GATHER_LENGTH
+    // 8 or 4 city ids from p in 32-bit lanes
+    template<class CityId>
+    static __m256i load8(const CityId* p)
+    {
+        if constexpr(sizeof(CityId) == 2) return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        else return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    template<class CityId>
+    static __m128i load4(const CityId* p)
+    {
+        if constexpr(sizeof(CityId) == 2) return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+        else return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+#endif
+    template<class CityId>
+    double matrixLength(const CityId* path, std::size_t cnt) const
     {
-        for(std::size_t i=0; i<cities.size(); i++)
+        double len = 0;
+        std::size_t i = 1;
+#ifdef TSP_GATHER_LENGTH
+        // the entries of a batch of edges are gathered by their indices from-city*stride+to-city
+        const __m256i strides = _mm256_set1_epi32(stride);
+        if constexpr(std::is_same_v<Distance, float>)
+        {
+            __m256d sum = _mm256_setzero_pd(); // the lanes are summed as doubles, so long paths don't lose precision
+            for(; i+8 <= cnt; i+=8)
+            {
+                __m256i from = load8(path+i-1), to = load8(path+i);
+                __m256 edges = _mm256_i32gather_ps(reinterpret_cast<const float*>(dists.get()), _mm256_add_epi32(_mm256_mullo_epi32(from, strides), to), 4);
+                sum = _mm256_add_pd(sum, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(edges)), _mm256_cvtps_pd(_mm256_extractf128_ps(edges, 1))));
+            }
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, sum);
+            for(double lane: lanes)
+                len += lane;
+        }
+        else
         {
-            distsSqr.reserve(i+1);
-            for(std::size_t j=0; j<i; j++)
-                distsSqr[i].push_back(cities[i].distance(cities[j]));
-            distsSqr[i].push_back(0);
+            __m256d sum = _mm256_setzero_pd();
+            for(; i+4 <= cnt; i+=4)
+            {
+                __m128i from = load4(path+i-1), to = load4(path+i);
+                __m128i index = _mm_add_epi32(_mm_mullo_epi32(from, _mm256_castsi256_si128(strides)), to);
+                sum = _mm256_add_pd(sum, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), reinterpret_cast<const double*>(dists.get()),
+                                                                  index, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8));
+            }
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, sum);
+            for(double lane: lanes)
+                len += lane;
         }
+#endif
+        for(; i<cnt; i++)
+            len += dists[path[i-1]*stride+path[i]];
+        return len;
     }
 public:
-    TSP_Map(const std::vector<Point>& cities): distsSqr(cities.size())
+    TSP_Map(const std::vector<Point>& cities, Metric metric = Metric::Euclidean): points(cities), metric(metric)
     {
-        initDistances(cities);
+        initDistances();
     }
     double distance(int i, int j) const
     {
-        return j<=i? distsSqr[i][j]: distsSqr[j][i];
+        return dists? dists[i*stride+j]: metricDistance(points[i], points[j], metric);
+    }
+    // of the path through the cnt cities path points to
+    template<class CityId>
+    double length(const CityId* path, std::size_t cnt) const
+    {
+        if(dists) return matrixLength(path, cnt);
+        double len = 0;
+        for(std::size_t i=1; i<cnt; i++)
+            len += metricDistance(points[path[i-1]], points[path[i]], metric);
+        return len;
+    }
+    bool hasMatrix() const
+    {
+        return dists != nullptr;
     }
     std::size_t cities() const
     {
-        return distsSqr.size();
+        return points.size();
+    }
+    const std::vector<Point>& cityPoints() const
+    {
+        return points;
+    }
+};
+
+// the cities sorted into square cells of about CITIES_PER_CELL each, so the cities near a point are found
+// by looking at the cells around it
+class CityGrid
+{
+    double minX = 0, minY = 0, size = 1; // of a cell
+    int side = 1;
+    std::vector<std::uint32_t> start; // of the cities of each cell in sorted
+    std::vector<std::uint32_t> sorted, cellOfCity;
+public:
+    explicit CityGrid(const std::vector<Point>& points): cellOfCity(points.size())
+    {
+        double maxX = minX, maxY = minY;
+        if(!points.empty())
+        {
+            auto [left, right] = std::minmax_element(points.begin(), points.end(), [](const Point& a, const Point& b) { return a.x < b.x; });
+            auto [bottom, top] = std::minmax_element(points.begin(), points.end(), [](const Point& a, const Point& b) { return a.y < b.y; });
+            minX = left->x, maxX = right->x, minY = bottom->y, maxY = top->y;
+        }
+        side = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(points.size())/CITIES_PER_CELL))));
+        if(double extent = std::max(maxX-minX, maxY-minY); extent > 0)
+            size = extent/side;
+        start.assign(side*side+1, 0);
+        for(std::size_t i=0; i<points.size(); i++)
+        {
+            int x = std::min(side-1, static_cast<int>((points[i].x-minX)/size)),
+                y = std::min(side-1, static_cast<int>((points[i].y-minY)/size));
+            start[(cellOfCity[i] = y*side+x)+1]++;
+        }
+        std::partial_sum(start.begin(), start.end(), start.begin());
+        sorted.resize(points.size());
+        std::vector<std::uint32_t> next(start.begin(), start.end()-1);
+        for(std::size_t i=0; i<points.size(); i++)
+            sorted[next[cellOfCity[i]]++] = i;
+    }
+    int cellsPerSide() const
+    {
+        return side;
+    }
+    double cellSize() const
+    {
+        return size;
+    }
+    std::size_t cellOf(std::size_t city) const
+    {
+        return cellOfCity[city];
+    }
+    // the cities of cell are sortedCities()[cellStart(cell)], ..., sortedCities()[cellStart(cell+1)-1]
+    std::size_t cellStart(std::size_t cell) const
+    {
+        return start[cell];
+    }
+    const std::vector<std::uint32_t>& sortedCities() const
+    {
+        return sorted;
+    }
+    // calls f with each cell whose distance to the cell of city, in cells along x or y, is r;
+    // the cities in them are at least (r-1)*cellSize() away from city
+    template<class F>
+    void forEachCellInRing(std::size_t city, int r, F&& f) const
+    {
+        const int x = cellOfCity[city]%side, y = cellOfCity[city]/side;
+        for(int j=std::max(y-r, 0); j<=std::min(y+r, side-1); j++)
+        {
+            const int step = j == y-r || j == y+r? 1: 2*r; // only the ends of the middle rows are in the ring
+            for(int i=x-r; i<=x+r; i+=step)
+                if(i >= 0 && i < side)
+                    f(static_cast<std::size_t>(j*side+i));
+        }
     }
 };
 
+// the k nearest cities of each city, nearest first, found with a grid instead of by comparing all pairs; they are
+// ranked by the plain Euclidean distance, which the grid bounds and which every metric grows with
+class NeighbourLists
+{
+    CityGrid cityGrid;
+    std::size_t k;
+    std::vector<std::uint32_t> ids;
+    std::vector<double> dists;
+public:
+    NeighbourLists(const TSP_Map& map, std::size_t k): cityGrid(map.cityPoints()),
+        k(std::min(k, map.cities() ? map.cities()-1: 0)), ids(map.cities()*this->k), dists(ids.size())
+    {
+        std::vector<std::pair<double, std::uint32_t>> found; // the nearest so far, sorted
+        found.reserve(this->k+1);
+        for(std::size_t city=0; city<map.cities() && this->k; city++)
+        {
+            found.clear();
+            for(int r=0; r<cityGrid.cellsPerSide() && !(found.size() == this->k && found.back().first <= (r-1)*cityGrid.cellSize()); r++)
+                cityGrid.forEachCellInRing(city, r, [&](std::size_t cell) {
+                    for(std::size_t i=cityGrid.cellStart(cell); i<cityGrid.cellStart(cell+1); i++)
+                    {
+                        std::uint32_t other = cityGrid.sortedCities()[i];
+                        double d = map.cityPoints()[city].distance(map.cityPoints()[other]);
+                        if(other == city || (found.size() == this->k && d >= found.back().first)) continue;
+                        found.insert(std::upper_bound(found.begin(), found.end(), std::pair(d, other)), {d, other});
+                        if(found.size() > this->k) found.pop_back();
+                    }
+                });
+            for(std::size_t i=0; i<found.size(); i++)
+            {
+                ids[city*this->k+i] = found[i].second;
+                dists[city*this->k+i] = map.distance(city, found[i].second);
+            }
+        }
+    }
+    std::size_t size() const
+    {
+        return k;
+    }
+    const std::uint32_t* of(std::size_t city) const
+    {
+        return ids.data()+city*k;
+    }
+    const double* distancesOf(std::size_t city) const
+    {
+        return dists.data()+city*k;
+    }
+    const CityGrid& grid() const
+    {
+        return cityGrid;
+    }
+};
+
+// a path stored in a population: it points to its cities and its length, which change through it
+template<class CityId>
 class Path
 {
-    const TSP_Map& map;
-    std::vector<int> path;
-    double len;
+    const TSP_Map* map;
+    CityId* path;
+    std::size_t cnt;
+    double* len;
     double calcLength() const
     {
-        double len = 0;
-        for(std::size_t i=1; i<path.size(); i++)
-            len += map.distance(path[i-1], path[i]);
-        return len;
+        return map->length(path, cnt);
     }
-    Path createChild(const Path& parent2, unsigned start, unsigned end) const
+    // the cities of this between start and end stay in their places and the rest are filled in the order they come in
+    // parent2 after end; usedCities is scratch space with a flag for each city
+    void createChild(const Path& parent2, unsigned start, unsigned end, Path& child, std::vector<bool>& usedCities) const
     {
-        std::vector<int> newPath(path.size());
-        std::vector<bool> usedCities(path.size());
+        std::fill(usedCities.begin(), usedCities.end(), false);
         for(unsigned i=start; i<=end; i++)
-            usedCities[newPath[i] = path[i]] = true;
-        auto copyFrom = parent2.path.begin()+end+1;
-        auto updateCopyFrom = [&copyFrom, &parent2, &usedCities] () -> decltype((copyFrom)) {
-            if(copyFrom == parent2.path.end()) copyFrom = parent2.path.begin();
+            usedCities[child.path[i] = path[i]] = true;
+        const CityId* copyFrom = parent2.path+end+1;
+        const CityId* parent2End = parent2.path+parent2.cnt;
+        auto updateCopyFrom = [&copyFrom, &parent2, parent2End, &usedCities] () -> decltype((copyFrom)) {
+            if(copyFrom == parent2End) copyFrom = parent2.path;
             while(usedCities[*copyFrom])
-                if(++copyFrom == parent2.path.end()) copyFrom = parent2.path.begin();
+                if(++copyFrom == parent2End) copyFrom = parent2.path;
             return copyFrom;
         };
-        for(unsigned i=end+1; i<newPath.size(); i++)
-            newPath[i] = *updateCopyFrom()++;
+        for(unsigned i=end+1; i<cnt; i++)
+            child.path[i] = *updateCopyFrom()++;
         for(unsigned i=0; i<start; i++)
-            newPath[i] = *updateCopyFrom()++;
-        return {map, newPath};
+            child.path[i] = *updateCopyFrom()++;
+        *child.len = child.calcLength();
     }
 public:
-    Path(const TSP_Map& map, const std::vector<int>& path): map(map), path(path), len(calcLength()) {}
+    Path(const TSP_Map& map, CityId* path, std::size_t cnt, double& len): map(&map), path(path), cnt(cnt), len(&len) {}
 
     double length() const
     {
-        return len;
+        return *len;
     }
     std::size_t cities() const
     {
-        return path.size();
+        return cnt;
+    }
+    CityId operator[](std::size_t i) const
+    {
+        return path[i];
+    }
+    void updateLength()
+    {
+        *len = calcLength();
+    }
+    // the distance between the cities at two positions; a position outside the path is a virtual city at distance 0
+    // from all, which closes the path into a cycle, so the moves need no special cases at its ends
+    double distanceAt(std::ptrdiff_t a, std::ptrdiff_t b) const
+    {
+        const std::ptrdiff_t n = cnt;
+        return a < 0 || b < 0 || a >= n || b >= n? 0: map->distance(path[a], path[b]);
+    }
+    // the changes of the length by the moves, in O(1), so that a move can be tested before it is made:
+    // swapping the cities at positions i and j
+    double swapDelta(std::size_t i, std::size_t j) const
+    {
+        if(i == j) return 0;
+        if(i > j) std::swap(i, j);
+        std::ptrdiff_t a = i, b = j;
+        if(b == a+1)
+            return distanceAt(a-1, b) + distanceAt(a, b+1) - distanceAt(a-1, a) - distanceAt(b, b+1);
+        return distanceAt(a-1, b) + distanceAt(b, a+1) + distanceAt(b-1, a) + distanceAt(a, b+1)
+             - distanceAt(a-1, a) - distanceAt(a, a+1) - distanceAt(b-1, b) - distanceAt(b, b+1);
+    }
+    // reversing positions i..j (2-opt)
+    double reverseDelta(std::size_t i, std::size_t j) const
+    {
+        if(i > j) std::swap(i, j);
+        std::ptrdiff_t a = i, b = j;
+        return distanceAt(a-1, b) + distanceAt(a, b+1) - distanceAt(a-1, a) - distanceAt(b, b+1);
+    }
+    // moving the cnt cities from position i, possibly reversed, to before position to, which is at most i-1
+    // or at least i+cnt+1 (Or-opt)
+    double moveSegmentDelta(std::size_t i, std::size_t cnt, std::size_t to, bool reversed) const
+    {
+        std::ptrdiff_t a = i, b = i+cnt-1, first = a, last = b, after = to;
+        if(reversed) std::swap(first, last);
+        return distanceAt(a-1, b+1) + distanceAt(after-1, first) + distanceAt(last, after)
+             - distanceAt(a-1, a) - distanceAt(b, b+1) - distanceAt(after-1, after);
+    }
+    void swapCities(std::size_t i, std::size_t j)
+    {
+        *len += swapDelta(i, j);
+        std::swap(path[i], path[j]);
+    }
+    void reverse(std::size_t i, std::size_t j)
+    {
+        *len += reverseDelta(i, j);
+        if(i > j) std::swap(i, j);
+        std::reverse(path+i, path+j+1);
+    }
+    void moveSegment(std::size_t i, std::size_t cnt, std::size_t to, bool reversed)
+    {
+        *len += moveSegmentDelta(i, cnt, to, reversed);
+        if(to < i)
+            std::rotate(path+to, path+i, path+i+cnt);
+        else
+        {
+            std::rotate(path+i, path+i+cnt, path+to);
+            to -= cnt;
+        }
+        if(reversed)
+            std::reverse(path+to, path+to+cnt);
+    }
+    void copyFrom(const Path& other)
+    {
+        std::copy(other.path, other.path+cnt, path);
+        *len = *other.len;
     }
     template<class Generator>
     void mutate(Generator&& gen)
     {
-        std::uniform_int_distribution<unsigned> dist(0, path.size()-1);
-        std::swap(path[dist(gen)], path[dist(gen)]);
-        len = calcLength();
+        std::uniform_int_distribution<unsigned> dist(0, cnt-1);
+        swapCities(dist(gen), dist(gen));
     }
     template<class Generator>
-    std::pair<Path, Path> crossover(const Path& parent2, Generator&& gen) const
+    void crossover(const Path& parent2, Path& child1, Path& child2, std::vector<bool>& usedCities, Generator&& gen) const
     {
-        if(&map != &parent2.map)
+        if(map != parent2.map)
             throw std::logic_error("cannot crossover paths over different maps");
-        std::uniform_int_distribution<unsigned> dist(0, path.size()-1);
+        std::uniform_int_distribution<unsigned> dist(0, cnt-1);
         unsigned i = dist(gen), j = dist(gen);
         if(i>j) std::swap(i, j);
-        return { createChild(parent2, i, j), parent2.createChild(*this, i, j) };
+        createChild(parent2, i, j, child1, usedCities);
+        parent2.createChild(*this, i, j, child2, usedCities);
     }
 };
 
 
-class Population
+// 2-opt and Or-opt moves that make a city adjacent to one of its nearest neighbours, made until none shortens the path;
+// a city whose moves were all checked in vain isn't checked again until one of its edges changes (its don't-look bit);
+// it also builds nearest neighbour tours for the local search to start from; it keeps scratch space, so each thread
+// needs its own
+template<class CityId>
+class LocalSearch
 {
-    std::vector<Path> members;
-    std::vector<double> totalFitnessUntil;
-    Path* best;
-    template<class Generator>
-    Path& chooseMember(Generator&& gen)
+    const TSP_Map& map;
+    const NeighbourLists& neighbours;
+    std::vector<std::uint32_t> position; // of each city in the path being improved
+    std::vector<CityId> pending;
+    std::vector<bool> isPending;
+    // the cities not yet in the tour being built, kept like the sorted cities of the grid
+    std::vector<std::uint32_t> remaining, indexInCell, remainingInCell;
+    void check(const Path<CityId>& path, std::ptrdiff_t i)
     {
-        return const_cast<Path&>(const_cast<const Population*>(this)->chooseMember(gen));
+        if(i >= 0 && i < static_cast<std::ptrdiff_t>(path.cities()) && !isPending[path[i]])
+        {
+            isPending[path[i]] = true;
+            pending.push_back(path[i]);
+        }
     }
-    template<class Generator>
-    const Path& chooseMember(Generator&& gen) const
+    void updatePositions(const Path<CityId>& path, std::size_t first, std::size_t last)
+    {
+        for(std::size_t i=first; i<last; i++)
+            position[path[i]] = i;
+    }
+    // a reversal that removes an edge of a and makes it adjacent to a neighbour c instead
+    bool twoOpt(Path<CityId>& path, CityId a)
+    {
+        const std::ptrdiff_t n = path.cities(), i = position[a];
+        for(int side: {1, -1})
+        {
+            if(i+side < 0 || i+side >= n) continue; // an edge to the virtual city costs nothing to keep
+            const double removed = path.distanceAt(i, i+side);
+            for(std::size_t m=0; m<neighbours.size() && neighbours.distancesOf(a)[m] < removed; m++)
+            {
+                const std::ptrdiff_t j = position[neighbours.of(a)[m]];
+                std::ptrdiff_t first, last;
+                if(side == 1) first = std::min(i, j)+1, last = std::max(i, j);
+                else first = std::min(i, j), last = std::max(i, j)-1;
+                if(first >= last || path.reverseDelta(first, last) > -MIN_IMPROVEMENT) continue;
+                path.reverse(first, last);
+                updatePositions(path, first, last+1);
+                for(std::ptrdiff_t k: {first-1, first, last, last+1})
+                    check(path, k);
+                return true;
+            }
+        }
+        return false;
+    }
+    // moving a segment that starts or ends with a next to a neighbour c
+    bool orOpt(Path<CityId>& path, CityId a)
+    {
+        const std::ptrdiff_t n = path.cities(), i = position[a];
+        for(std::ptrdiff_t len=1; len<=static_cast<std::ptrdiff_t>(OR_OPT_SEGMENT) && len<n; len++)
+            for(std::ptrdiff_t s: {i, i-len+1})
+            {
+                if(s < 0 || s+len > n || (len == 1 && s != i)) continue;
+                const bool aFirst = s == i;
+                const double removed = path.distanceAt(s-1, s) + path.distanceAt(s+len-1, s+len) - path.distanceAt(s-1, s+len);
+                for(std::size_t m=0; m<neighbours.size() && neighbours.distancesOf(a)[m] < removed; m++)
+                {
+                    const std::ptrdiff_t j = position[neighbours.of(a)[m]];
+                    if(j >= s && j < s+len) continue;
+                    // after c or before it, turned so that a is next to c
+                    for(auto [to, reversed]: {std::pair(j+1, !aFirst), std::pair(j, aFirst)})
+                    {
+                        if((to > s-1 && to < s+len+1) || path.moveSegmentDelta(s, len, to, reversed) > -MIN_IMPROVEMENT) continue;
+                        for(std::ptrdiff_t k: {s-1, s, s+len-1, s+len, to-1, to})
+                            check(path, k);
+                        path.moveSegment(s, len, to, reversed);
+                        updatePositions(path, std::min(s, to), std::max(s+len, to));
+                        return true;
+                    }
+                }
+            }
+        return false;
+    }
+    bool isRemaining(std::uint32_t city) const
+    {
+        return indexInCell[city] < neighbours.grid().cellStart(neighbours.grid().cellOf(city)) + remainingInCell[neighbours.grid().cellOf(city)];
+    }
+    void remove(std::uint32_t city)
+    {
+        const std::size_t cell = neighbours.grid().cellOf(city);
+        const std::uint32_t last = neighbours.grid().cellStart(cell) + --remainingInCell[cell], moved = remaining[last];
+        std::swap(remaining[indexInCell[city]], remaining[last]);
+        std::swap(indexInCell[city], indexInCell[moved]);
+    }
+    std::uint32_t nearestRemaining(std::uint32_t city) const
     {
-        std::uniform_real_distribution<> naturalSelection(0, totalFitnessUntil.back());
-        return members[std::lower_bound(totalFitnessUntil.begin(), totalFitnessUntil.end(), naturalSelection(gen)) - totalFitnessUntil.begin() - 1];
+        for(std::size_t m=0; m<neighbours.size(); m++)
+            if(isRemaining(neighbours.of(city)[m]))
+                return neighbours.of(city)[m];
+        const CityGrid& grid = neighbours.grid();
+        std::uint32_t nearest = city;
+        double nearestDistance = std::numeric_limits<double>::infinity();
+        for(int r=0; r<grid.cellsPerSide() && nearestDistance > (r-1)*grid.cellSize(); r++)
+            grid.forEachCellInRing(city, r, [&](std::size_t cell) {
+                for(std::size_t i=grid.cellStart(cell); i<grid.cellStart(cell)+remainingInCell[cell]; i++)
+                    if(double d = map.cityPoints()[city].distance(map.cityPoints()[remaining[i]]); d < nearestDistance)
+                        nearestDistance = d, nearest = remaining[i];
+            });
+        return nearest;
     }
 public:
+    LocalSearch(const TSP_Map& map, const NeighbourLists& neighbours): map(map), neighbours(neighbours),
+        position(map.cities()), isPending(map.cities()), remaining(map.cities()), indexInCell(map.cities()),
+        remainingInCell(neighbours.grid().cellsPerSide()*neighbours.grid().cellsPerSide())
+    {
+        pending.reserve(map.cities());
+    }
+    // every city is checked at first: a child keeps the edges of its parents, but not their directions, and
+    // the moves that can join two edges depend on them
+    void improve(Path<CityId>& path)
+    {
+        for(std::size_t i=path.cities(); i--; )
+            check(path, i);
+        for(std::size_t i=0; i<path.cities(); i++)
+            position[path[i]] = i;
+        while(!pending.empty())
+        {
+            CityId a = pending.back();
+            pending.pop_back();
+            isPending[a] = false;
+            while(twoOpt(path, a) || orOpt(path, a));
+        }
+        path.updateLength(); // the rounding errors of the deltas don't add up
+    }
+    // from a random city, always to the nearest city not yet in tour
     template<class Generator>
-    static Population createInitial(std::size_t size, const TSP_Map& map, Generator&& gen)
+    void nearestNeighbourTour(CityId* tour, Generator&& gen)
+    {
+        const CityGrid& grid = neighbours.grid();
+        remaining = grid.sortedCities();
+        for(std::size_t i=0; i<remaining.size(); i++)
+            indexInCell[remaining[i]] = i;
+        for(std::size_t cell=0; cell<remainingInCell.size(); cell++)
+            remainingInCell[cell] = grid.cellStart(cell+1) - grid.cellStart(cell);
+        std::uint32_t city = std::uniform_int_distribution<std::uint32_t>(0, map.cities()-1)(gen);
+        for(std::size_t i=0; i<map.cities(); i++)
+        {
+            remove(tour[i] = city);
+            if(i+1 < map.cities())
+                city = nearestRemaining(city);
+        }
+    }
+};
+
+// threads that stay for the whole run and are given jobs, which they call with their index;
+// the thread that gives a job takes index 0 and returns once all are done
+class WorkerPool
+{
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    void (*job)(void*, unsigned) = nullptr; // not a std::function, so giving a job doesn't allocate
+    void* jobContext = nullptr;
+    unsigned long long round = 0;
+    unsigned running = 0;
+    bool stopping = false;
+    std::vector<std::jthread> workers;
+    void work(unsigned index)
+    {
+        unsigned long long seen = 0;
+        for(;;)
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [&] { return stopping || round != seen; });
+            if(stopping) return;
+            seen = round;
+            lock.unlock();
+            job(jobContext, index);
+            lock.lock();
+            if(!--running) finished.notify_one();
+        }
+    }
+public:
+    explicit WorkerPool(unsigned threads)
+    {
+        for(unsigned t=1; t<threads; t++)
+            workers.emplace_back(&WorkerPool::work, this, t);
+    }
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+    }
+    unsigned size() const
+    {
+        return workers.size()+1;
+    }
+    template<class F>
+    void run(F& f)
     {
-        std::vector<Path> members;
-        std::vector<int> path(map.cities());
-        std::iota(path.begin(), path.end(), 0);
-        members.reserve(size);
-        while(size--)
         {
-            std::shuffle(path.begin(), path.end(), gen);
-            members.emplace_back(map, path);
+            std::lock_guard lock(mutex);
+            job = [](void* f, unsigned index) { (*static_cast<F*>(f))(index); };
+            jobContext = &f;
+            running = workers.size();
+            round++;
         }
-        return members;
+        wake.notify_all();
+        f(0);
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&] { return !running; });
     }
-    Population(std::vector<Path> members): members(std::move(members)), best(&this->members.at(0))
+};
+
+// a lock-free ring buffer that passes paths from one thread to another by copying them in and out; only the producer
+// moves the tail and only the consumer moves the head, so neither waits for the other
+template<class CityId>
+class PathRing
+{
+    const TSP_Map& map;
+    std::size_t capacity;
+    std::vector<CityId> cities;
+    std::vector<double> lengths;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    Path<CityId> slot(std::size_t i)
+    {
+        i %= capacity;
+        return {map, cities.data()+i*map.cities(), map.cities(), lengths[i]};
+    }
+public:
+    PathRing(const TSP_Map& map, std::size_t capacity): map(map), capacity(std::max<std::size_t>(capacity, 1)),
+        cities(this->capacity*map.cities()), lengths(this->capacity) {}
+    // false if it is full
+    bool push(const Path<CityId>& path)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if(t-head.load(std::memory_order_acquire) == capacity)
+            return false;
+        slot(t).copyFrom(path);
+        tail.store(t+1, std::memory_order_release);
+        return true;
+    }
+    // false if it is empty
+    bool pop(Path<CityId>& path)
     {
-        totalFitnessUntil.reserve(size()+1);
-        totalFitnessUntil.push_back(-0.0);
-        for(Path& path: this->members)
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire))
+            return false;
+        path.copyFrom(slot(h));
+        head.store(h+1, std::memory_order_release);
+        return true;
+    }
+};
+
+// how parents and survivors are chosen: by roulette, with weights inverse to the lengths, or the shortest of
+// TOURNAMENT_SIZE chosen uniformly
+enum class Selection
+{
+    Roulette,
+    Tournament
+};
+
+// the members and their children are in one buffer of city ids, a path after another, with their lengths in another;
+// the survivors are copied to a second pair of buffers, which then take the place of the first, so once they are
+// allocated a generation allocates nothing; the children are bred by a pool of threads, each filling its share of
+// the pairs of slots with its own random stream (from the seed and its index) and scratch space, so a run depends only
+// on the seed and the number of threads; with neighbour lists the members start as nearest neighbour tours and each
+// of them and of the children is improved by local search (a memetic algorithm);
+// a parent is chosen in O(1), by roulette from an alias table built once a generation or by tournament
+template<class CityId>
+class Population
+{
+    struct alignas(64) Breeder
+    {
+        std::mt19937 mt;
+        std::vector<bool> usedCities; // crossover scratch space
+        std::optional<LocalSearch<CityId>> localSearch;
+    };
+    const TSP_Map& map;
+    std::size_t membersCnt;
+    std::vector<CityId> cities, nextCities;
+    std::vector<double> lengths, nextLengths;
+    Selection selection;
+    std::vector<std::uint32_t> alias, aliasWork; // the roulette of the members
+    std::vector<double> aliasProbability;
+    std::vector<std::uint32_t> candidates; // the slots that may survive
+    std::vector<double> keys;
+    std::vector<Breeder> breeders;
+    WorkerPool pool;
+    std::size_t best = 0, bestChild = 0;
+    std::size_t slots() const
+    {
+        return 2*membersCnt + membersCnt%2; // the children come in pairs
+    }
+    Path<CityId> slot(std::size_t i)
+    {
+        return {map, cities.data()+i*map.cities(), map.cities(), lengths[i]};
+    }
+    std::size_t bestIn(std::size_t first, std::size_t last) const
+    {
+        return std::min_element(lengths.begin()+first, lengths.begin()+last) - lengths.begin();
+    }
+    // inverse to the length, relative to the best one, so that paths of length 0 need no special case
+    double weight(std::size_t i) const
+    {
+        return lengths[i] > 0? std::min(lengths[best], lengths[bestChild])/lengths[i]: 1;
+    }
+    // Vose's alias method: column i of the table is member i with probability aliasProbability[i], else member alias[i],
+    // and the columns are equally likely
+    void buildAliasTable()
+    {
+        double total = 0;
+        for(std::size_t i=0; i<membersCnt; i++)
+            total += weight(i);
+        std::size_t smallEnd = 0, largeBegin = membersCnt; // the columns under and over 1 are at each end of aliasWork
+        for(std::size_t i=0; i<membersCnt; i++)
         {
-            totalFitnessUntil.push_back(totalFitnessUntil.back()+path.length());
-            if(path.length() < best->length())
-                best = &path;
+            aliasProbability[i] = weight(i)*membersCnt/total;
+            aliasWork[aliasProbability[i] < 1? smallEnd++: --largeBegin] = i;
         }
+        while(smallEnd && largeBegin < membersCnt)
+        {
+            std::uint32_t small = aliasWork[--smallEnd], large = aliasWork[largeBegin];
+            alias[small] = large;
+            if((aliasProbability[large] -= 1-aliasProbability[small]) < 1)
+            {
+                largeBegin++;
+                aliasWork[smallEnd++] = large;
+            }
+        }
+        for(std::size_t i=0; i<smallEnd; i++) // left over only by rounding errors
+            aliasProbability[aliasWork[i]] = 1;
+        for(std::size_t i=largeBegin; i<membersCnt; i++)
+            aliasProbability[aliasWork[i]] = 1;
     }
     template<class Generator>
-    Population children(Generator&& gen) const
+    std::size_t chooseParent(Generator&& gen) const
+    {
+        std::uniform_int_distribution<std::size_t> dist(0, membersCnt-1);
+        std::size_t chosen = dist(gen);
+        if(selection == Selection::Roulette)
+            return std::uniform_real_distribution<>()(gen) < aliasProbability[chosen]? chosen: alias[chosen];
+        for(std::size_t i=1; i<TOURNAMENT_SIZE; i++)
+            if(std::size_t other = dist(gen); lengths[other] < lengths[chosen])
+                chosen = other;
+        return chosen;
+    }
+public:
+    Population(std::size_t size, const TSP_Map& map, unsigned long seed, unsigned threads,
+               Selection selection = Selection::Roulette, const NeighbourLists* neighbours = nullptr):
+        map(map), membersCnt(size), cities(slots()*map.cities()), nextCities(cities.size()), lengths(slots()),
+        nextLengths(slots()), selection(selection), alias(size), aliasWork(size), aliasProbability(size),
+        candidates(2*size), keys(2*size), pool(threads)
     {
-        std::bernoulli_distribution hasMutation(MUTATION_PROBABILITY);
-        std::vector<Path> children;
-        while(children.size() < size())
+        if(!size)
+            throw std::invalid_argument("a population cannot be empty");
+        for(unsigned t=0; t<threads; t++)
         {
-            auto [child1, child2] = chooseMember(gen).crossover(chooseMember(gen), gen);
-            if(hasMutation(gen)) child1.mutate(gen);
-            if(hasMutation(gen)) child2.mutate(gen);
-            children.push_back(std::move(child1));
-            children.push_back(std::move(child2));
+            std::seed_seq seq{seed, static_cast<unsigned long>(t)};
+            breeders.push_back({std::mt19937(seq), std::vector<bool>(map.cities()), std::nullopt});
+            if(neighbours)
+                breeders.back().localSearch.emplace(map, *neighbours);
         }
-        return children;
+        auto initShare = [this](unsigned t) {
+            Breeder& breeder = breeders[t];
+            for(std::size_t i=membersCnt*t/breeders.size(); i<membersCnt*(t+1)/breeders.size(); i++)
+            {
+                Path<CityId> member = slot(i);
+                CityId* path = cities.data()+i*this->map.cities();
+                if(breeder.localSearch)
+                    breeder.localSearch->nearestNeighbourTour(path, breeder.mt);
+                else
+                {
+                    std::iota(path, path+this->map.cities(), 0);
+                    std::shuffle(path, path+this->map.cities(), breeder.mt);
+                }
+                member.updateLength();
+                if(breeder.localSearch)
+                    breeder.localSearch->improve(member);
+            }
+        };
+        pool.run(initShare);
+        best = bestChild = bestIn(0, size);
+        if(selection == Selection::Roulette)
+            buildAliasTable();
+    }
+    void breed()
+    {
+        auto breedShare = [this](unsigned t) {
+            Breeder& breeder = breeders[t];
+            std::bernoulli_distribution hasMutation(MUTATION_PROBABILITY);
+            std::size_t pairs = (membersCnt+1)/2, first = pairs*t/breeders.size(), last = pairs*(t+1)/breeders.size();
+            for(std::size_t i=membersCnt+2*first; i<membersCnt+2*last; i+=2)
+            {
+                Path<CityId> child1 = slot(i), child2 = slot(i+1);
+                slot(chooseParent(breeder.mt)).crossover(slot(chooseParent(breeder.mt)), child1, child2,
+                                                         breeder.usedCities, breeder.mt);
+                if(hasMutation(breeder.mt)) child1.mutate(breeder.mt);
+                if(hasMutation(breeder.mt)) child2.mutate(breeder.mt);
+                if(breeder.localSearch)
+                {
+                    breeder.localSearch->improve(child1);
+                    breeder.localSearch->improve(child2);
+                }
+            }
+        };
+        pool.run(breedShare);
+        bestChild = bestIn(membersCnt, 2*membersCnt);
     }
+    // the best member and the best child survive, and the rest are chosen, without repetition, among the other
+    // members and children: by roulette, the parents taking KEEP_PARENT_PROBABILITY of the wheel and the children
+    // the rest, or by tournaments; either way in O(1) for each survivor, without draws that have to be repeated
     template<class Generator>
-    Population select(Population&& children, Generator&& gen)
-    {
-        std::bernoulli_distribution keepParent(KEEP_PARENT_PROBABILITY);
-        std::vector<Path> newMembers;
-        newMembers.reserve(size());
-        newMembers.push_back(std::move(*best));
-        newMembers.push_back(std::move(*children.best));
-        while(newMembers.size() < size())
+    void select(Generator&& gen)
+    {
+        std::size_t survivors = 0, candidatesCnt = 0;
+        auto survive = [&](std::size_t i) {
+            std::copy_n(cities.begin()+i*map.cities(), map.cities(), nextCities.begin()+survivors*map.cities());
+            nextLengths[survivors++] = lengths[i];
+        };
+        survive(best);
+        if(membersCnt > 1)
+            survive(bestChild);
+        for(std::size_t i=0; i<2*membersCnt; i++)
+            if(i != best && i != bestChild)
+                candidates[candidatesCnt++] = i;
+        const std::size_t chosenCnt = membersCnt-survivors;
+        if(selection == Selection::Roulette)
         {
-            Path& chosenMember = keepParent(gen)? chooseMember(gen): children.chooseMember(gen);
-            if(chosenMember.cities()) // if member has not been chosen yet
-                newMembers.push_back(std::move(chosenMember));
+            // weighted sampling without replacement (Efraimidis and Spirakis): the ones with the largest log(u)/weight
+            double membersWeight = 0, childrenWeight = 0;
+            for(std::size_t i=0; i<candidatesCnt; i++)
+                (candidates[i] < membersCnt? membersWeight: childrenWeight) += weight(candidates[i]);
+            std::uniform_real_distribution<> dist;
+            for(std::size_t i=0; i<candidatesCnt; i++)
+            {
+                std::uint32_t c = candidates[i];
+                double w = weight(c)*(c < membersCnt? KEEP_PARENT_PROBABILITY/membersWeight: (1-KEEP_PARENT_PROBABILITY)/childrenWeight);
+                keys[c] = w > 0? std::log1p(-dist(gen))/w: -std::numeric_limits<double>::infinity();
+            }
+            std::nth_element(candidates.begin(), candidates.begin()+chosenCnt, candidates.begin()+candidatesCnt,
+                             [this](std::uint32_t a, std::uint32_t b) { return keys[a] > keys[b]; });
         }
-        return newMembers;
+        else
+            for(std::size_t i=0; i<chosenCnt; i++) // a partial Fisher-Yates shuffle, in which the winners are moved
+            {
+                std::uniform_int_distribution<std::size_t> dist(i, candidatesCnt-1);
+                std::size_t winner = dist(gen);
+                for(std::size_t j=1; j<TOURNAMENT_SIZE; j++)
+                    if(std::size_t other = dist(gen); lengths[candidates[other]] < lengths[candidates[winner]])
+                        winner = other;
+                std::swap(candidates[i], candidates[winner]);
+            }
+        for(std::size_t i=0; i<chosenCnt; i++)
+            survive(candidates[i]);
+        cities.swap(nextCities);
+        lengths.swap(nextLengths);
+        best = bestChild = bestIn(0, membersCnt);
+        if(selection == Selection::Roulette)
+            buildAliasTable();
     }
-    const Path& bestMember() const
+    // copies of the cnt best members go to out, as many as immigrate takes in, so out never fills up with ones
+    // that are not taken
+    void emigrate(std::size_t cnt, PathRing<CityId>& out)
     {
-        return *best;
+        cnt = std::min(cnt, membersCnt-1);
+        std::iota(candidates.begin(), candidates.begin()+membersCnt, 0);
+        std::partial_sort(candidates.begin(), candidates.begin()+cnt, candidates.begin()+membersCnt,
+                          [this](std::uint32_t a, std::uint32_t b) { return lengths[a] < lengths[b]; });
+        for(std::size_t i=0; i<cnt; i++)
+            if(!out.push(slot(candidates[i])))
+                break;
+    }
+    // up to cnt paths that came to in replace the worst members
+    void immigrate(std::size_t cnt, PathRing<CityId>& in)
+    {
+        cnt = std::min(cnt, membersCnt-1); // the best stays
+        std::iota(candidates.begin(), candidates.begin()+membersCnt, 0);
+        std::partial_sort(candidates.begin(), candidates.begin()+cnt, candidates.begin()+membersCnt,
+                          [this](std::uint32_t a, std::uint32_t b) { return lengths[a] > lengths[b]; });
+        for(std::size_t i=0; i<cnt; i++)
+            if(Path<CityId> worst = slot(candidates[i]); !in.pop(worst))
+                break;
+        best = bestChild = bestIn(0, membersCnt);
+        if(selection == Selection::Roulette)
+            buildAliasTable();
+    }
+    Path<CityId> bestMember()
+    {
+        return slot(best);
     }
     std::size_t size() const
     {
-        return members.size();
+        return membersCnt;
     }
 };
 
@@ -229,26 +1176,175 @@ const std::vector<Point> testPoints {
     { 217.343,-447.089 },
 };
 
-int main() try
+struct Settings
 {
-    //std::size_t n;
-    //std::cin >> n;
-    auto start = std::chrono::steady_clock::now();
+    std::size_t populationSize = POPULATION_SIZE, iterations = ITERATIONS;
+    unsigned threads = 1;
+    unsigned long seed = 0;
+    bool localSearch = false;
+    Selection selection = Selection::Roulette;
+    unsigned islands = 1;
+    std::size_t migrationInterval = MIGRATION_INTERVAL, migrants = MIGRANTS;
+};
 
-    std::mt19937 mt(std::chrono::system_clock::now().time_since_epoch().count());
-    const TSP_Map map(/*randPoints(n, MIN_COORDINATE, MAX_COORDINATE, mt)*/testPoints);
-    Population p = Population::createInitial(POPULATION_SIZE, map, mt);
+// runs the genetic algorithm with paths of CityId, which is the smallest type that fits the cities of map;
+// with more than one island, each population evolves in its own thread, with a share of the threads for breeding,
+// and every migrationInterval generations sends copies of its best members around a ring of PathRings to the next one,
+// where they replace the worst; the islands wait for each other to exchange them and to report the best of all,
+// so a run still depends only on the seed and the number of threads
+template<class CityId>
+std::vector<std::uint32_t> evolve(const TSP_Map& map, const Settings& settings)
+{
+    std::optional<NeighbourLists> neighbours;
+    if(settings.localSearch)
+        neighbours.emplace(map, NEAREST_NEIGHBOURS);
+    const unsigned islands = settings.islands;
+    std::vector<std::unique_ptr<Population<CityId>>> populations;
+    std::vector<std::unique_ptr<PathRing<CityId>>> rings; // from each island to the next one
+    for(unsigned island=0; island<islands; island++)
+    {
+        populations.push_back(std::make_unique<Population<CityId>>(settings.populationSize, map, settings.seed+island,
+                                                                   std::max(settings.threads/islands, 1u),
+                                                                   settings.selection, neighbours? &*neighbours: nullptr));
+        rings.push_back(std::make_unique<PathRing<CityId>>(map, 2*settings.migrants)); // room for the next ones too
+    }
     std::cout << std::fixed;
     std::cout.precision(3);
-    for(std::size_t i=0; i<ITERATIONS; i++)
+    const std::size_t reportEvery = std::max<std::size_t>(settings.iterations/20, 1);
+    std::vector<double> bests(islands);
+    std::size_t reports = 0;
+    auto report = [&]() noexcept {
+        std::cout << "after iteration " << std::setw(8) << std::min(reports++*reportEvery, settings.iterations) << ": "
+                  << std::setw(10) << *std::min_element(bests.begin(), bests.end()) << '\n';
+    };
+    std::barrier reportSync(islands, report), migrationSync(islands);
+    std::vector<std::chrono::steady_clock::duration> selectionTimes(islands);
+    auto run = [&](unsigned island) {
+        Population<CityId>& p = *populations[island];
+        std::mt19937 mt(settings.seed+island);
+        for(std::size_t i=0; i<settings.iterations; i++)
+        {
+            if(!(i%reportEvery))
+            {
+                bests[island] = p.bestMember().length();
+                reportSync.arrive_and_wait();
+            }
+            p.breed();
+            auto selectionStart = std::chrono::steady_clock::now();
+            p.select(mt);
+            selectionTimes[island] += std::chrono::steady_clock::now()-selectionStart;
+            if(islands > 1 && settings.migrants && !((i+1)%settings.migrationInterval))
+            {
+                p.emigrate(settings.migrants, *rings[island]);
+                migrationSync.arrive_and_wait();
+                p.immigrate(settings.migrants, *rings[(island+islands-1)%islands]);
+            }
+        }
+        bests[island] = p.bestMember().length();
+        reportSync.arrive_and_wait();
+    };
+    {
+        std::vector<std::jthread> others;
+        for(unsigned island=1; island<islands; island++)
+            others.emplace_back(run, island);
+        run(0);
+    }
+    std::cerr << "selection time: " << std::fixed << std::setprecision(6)
+              << std::chrono::duration<double>(std::accumulate(selectionTimes.begin(), selectionTimes.end(),
+                                                               std::chrono::steady_clock::duration{})).count() << " s\n";
+    Population<CityId>& bestIsland = *populations[std::min_element(bests.begin(), bests.end()) - bests.begin()];
+    std::vector<std::uint32_t> best(map.cities());
+    for(std::size_t i=0; i<map.cities(); i++)
+        best[i] = bestIsland.bestMember()[i];
+    return best;
+}
+
+// a city per line, by its name if there are names, else by its number in the input, from 1
+void writeTour(std::ostream& out, const std::vector<std::uint32_t>& tour, const std::vector<std::string>& names)
+{
+    for(std::uint32_t city: tour)
+        if(names.empty()) out << city+1 << '\n';
+        else out << names[city] << '\n';
+    if(!out)
+        throw std::runtime_error("cannot write the tour");
+}
+
+int main(int argc, char** argv) try
+{
+    Settings settings;
+    settings.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    settings.seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::size_t randomCities = 0;
+    std::string citiesPath, namesPath, tourPath;
+    for(int i=1; i<argc; i++)
+        if(!std::strcmp(argv[i], "--threads") && i+1 < argc)
+            settings.threads = std::max(std::stoul(argv[++i]), 1ul);
+        else if(!std::strcmp(argv[i], "--seed") && i+1 < argc)
+            settings.seed = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--population") && i+1 < argc)
+            settings.populationSize = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--iterations") && i+1 < argc)
+            settings.iterations = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--random") && i+1 < argc)
+            randomCities = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--local-search"))
+            settings.localSearch = true;
+        else if(!std::strcmp(argv[i], "--selection") && i+1 < argc && !std::strcmp(argv[i+1], "roulette"))
+            settings.selection = Selection::Roulette, i++;
+        else if(!std::strcmp(argv[i], "--selection") && i+1 < argc && !std::strcmp(argv[i+1], "tournament"))
+            settings.selection = Selection::Tournament, i++;
+        else if(!std::strcmp(argv[i], "--islands") && i+1 < argc)
+            settings.islands = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--migration-interval") && i+1 < argc)
+            settings.migrationInterval = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--migrants") && i+1 < argc)
+            settings.migrants = std::stoul(argv[++i]);
+        else if(!std::strcmp(argv[i], "--load") && i+1 < argc)
+            citiesPath = argv[++i];
+        else if(!std::strcmp(argv[i], "--names") && i+1 < argc)
+            namesPath = argv[++i];
+        else if(!std::strcmp(argv[i], "--tour") && i+1 < argc)
+            tourPath = argv[++i];
+        else throw std::invalid_argument(std::string("Usage: ") + *argv + " [--threads <count>] [--seed <seed>] "
+                                         "[--population <size>] [--iterations <count>] [--selection roulette|tournament] [--local-search] "
+                                         "[--islands <count> [--migration-interval <generations>] [--migrants <count>]] "
+                                         "[--random <cities> | --load <x,y csv or .tsp> [--names <file>]] [--tour <file or ->]");
+    if(!settings.islands || !settings.migrationInterval)
+        throw std::invalid_argument("--islands and --migration-interval must be positive");
+    if(randomCities && !citiesPath.empty())
+        throw std::invalid_argument("--random and --load cannot be used together");
+    if(!namesPath.empty() && citiesPath.empty())
+        throw std::invalid_argument("--names needs --load");
+    auto start = std::chrono::steady_clock::now();
+
+    std::mt19937 mt(settings.seed);
+    std::vector<Point> points = testPoints;
+    Metric metric = Metric::Euclidean;
+    std::vector<std::string> names;
+    if(randomCities)
+        points = randPoints(randomCities, MIN_COORDINATE, MAX_COORDINATE, mt);
+    else if(!citiesPath.empty())
+    {
+        points = loadCities(citiesPath, metric);
+        if(!namesPath.empty())
+            names = loadNames(namesPath, points.size());
+        std::cerr << "loaded " << points.size() << " cities in " << std::fixed << std::setprecision(6)
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count() << " s\n";
+    }
+    if(points.empty())
+        throw std::invalid_argument("there are no cities");
+    const TSP_Map map(points, metric);
+    std::vector<std::uint32_t> tour = map.cities() <= std::numeric_limits<std::uint16_t>::max()+1?
+        evolve<std::uint16_t>(map, settings): evolve<std::uint32_t>(map, settings);
+    if(tourPath == "-")
+        writeTour(std::cout, tour, names);
+    else if(!tourPath.empty())
     {
-        if(!(i%(ITERATIONS/20)))
-            std::cout << "after iteration " << std::setw(8) << i << ": " << std::setw(10) << p.bestMember().length() << '\n';
-        p = p.select(p.children(mt), mt);
+        std::ofstream out(tourPath);
+        writeTour(out, tour, names);
     }
 
     auto end = std::chrono::steady_clock::now();
-    std::cout << "after iteration " << std::setw(8) << ITERATIONS << ": " << std::setw(10) << p.bestMember().length() << '\n';
     std::cerr.precision(6);
     std::cerr << "elapsed time: " << std::fixed << std::chrono::duration<double>(end-start).count() << " s\n";
 }